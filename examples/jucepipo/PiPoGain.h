@@ -18,13 +18,14 @@ class PiPoGain : public PiPo
 {
 private:
   std::vector<PiPoValue> buffer;
+  bool inplace;
 
 public:
-  PiPoScalarAttr<double> factor;
+  PiPoSmoothedAttr factor;
   
   PiPoGain (Parent *parent, PiPo *receiver = NULL)
-  : PiPo(parent, receiver), 
-    factor(this, "factor", "Gain Factor", false, 1.0)
+  : PiPo(parent, receiver), inplace(false),
+    factor(this, "factor", "Gain Factor", false, 1.0, 20.0)
   { }
   
   ~PiPoGain (void)
@@ -35,8 +36,11 @@ public:
                         const char **labels, bool hasVarSize,
                         double domain, unsigned int maxFrames)
   {
-    // A general pipo can not work in place, we need to create an output buffer
-    buffer.resize(width * height * maxFrames);
+    // work in place if the sender allows it, otherwise we need to create an output buffer
+    inplace = isInputWritable();
+    buffer.resize(inplace ? 0 : width * height * maxFrames);
+    setOutputWritable(true);
+    factor.setFrameRate(rate); // smooth factor changes over 20 ms
     return propagateStreamAttributes(hasTimeTags, rate, offset, width, height,
                                      labels, hasVarSize, domain, maxFrames);
   }
@@ -44,19 +48,18 @@ public:
   int frames (double time, double weight, PiPoValue *values,
               unsigned int size, unsigned int num)
   {
-    double f = factor.get(); // get gain factor here, as it could change while running
-    PiPoValue *ptr = &buffer[0];
-	
-    for (unsigned int i = 0; i < num; i++)
+    PiPoValue *out = inplace ? values : &buffer[0];
+
+    // get gain factor here, as it could change while running, ramping to it in linear segments
+    for (unsigned int i = 0, n; i < num; i += n)
     {
-      for (unsigned int j = 0; j < size; j++)
-	ptr[j] = values[j] * f;
+      double start, end;
 
-      ptr    += size;
-      values += size;
+      n = factor.ramp(num - i, start, end);
+      PiPoRamp::applyLinear(values + (size_t) i * size, out + (size_t) i * size, size, size, n, start, (end - start) / n);
     }
     
-    return propagateFrames(time, weight, &buffer[0], size, num);
+    return propagateFrames(time, weight, out, size, num);
   }
 };
 
@@ -19,13 +19,17 @@ class PiPoGain : public PiPo
 private:
   std::vector<PiPoValue> buffer_;
   unsigned int           framesize_;    // cache max frame size
+  bool                   inplace_;      // write output over input
+  double                 lastfactor_;   // factor applied to the last frame
 
 public:
-  PiPoScalarAttr<double> factor_attr_;
+  PiPoSmoothedAttr       factor_attr_;
+  PiPoScalarAttr<double> ramptime_attr_;
 
   PiPoGain (Parent *parent, PiPo *receiver = NULL)
-  : PiPo(parent, receiver),
-    factor_attr_(this, "factor", "Gain Factor", false, 1.0)
+  : PiPo(parent, receiver), framesize_(0), inplace_(false), lastfactor_(1.0),
+    factor_attr_(this, "factor", "Gain Factor", false, 1.0),
+    ramptime_attr_(this, "ramptime", "Ramp Time of Gain Factor Changes [ms]", false, 0.0)
   { }
 
   ~PiPoGain (void)
@@ -42,30 +46,63 @@ public:
     // we need to store the max frame size in case hasVarSize is true
     framesize_ = width * height; 
 
-    // A general pipo can not work in place, we need to create an output buffer
-    buffer_.resize(framesize_ * maxFrames);
+    // we can work in place if the sender allows to overwrite its output, otherwise we need to create an output buffer
+    inplace_ = isInputWritable();
+    buffer_.resize(inplace_  ?  0  :  framesize_ * maxFrames);
+
+    // either way, we don't read our output again, so the receiver may overwrite it
+    setOutputWritable(true);
+
+    // changes of the factor are smoothed over the ramp time, counted in frames
+    factor_attr_.setFrameRate(rate);
 
     // we will produce the same stream layout as the input
     return propagateStreamAttributes(hasTimeTags, rate, offset, width, height,
                                      labels, hasVarSize, domain, maxFrames);
   }
 
+  int reset (void)
+  {
+    // start the next stream at the factor set
+    factor_attr_.jump();
+    lastfactor_ = factor_attr_.getCurrent();
+
+    return propagateReset();
+  }
+
   int frames (double time, double weight, PiPoValue *values,
               unsigned int size, unsigned int num)
   {
-    double     f      = factor_attr_.get(); // get gain factor here, as it could change while running
-    PiPoValue *outptr = &buffer_[0];
+    PiPoValue *outbuf = inplace_  ?  values  :  &buffer_[0];
+    unsigned int activity = getInputActivity();
+    bool silent = (activity & ActivitySilent) != 0;
 
-    for (unsigned int i = 0; i < num; i++)
+    factor_attr_.setRampTime(ramptime_attr_.get()); // for the next change of the factor
+
+    // advance the factor (it could change while running) in linear segments over the block
+    for (unsigned int i = 0, n; i < num; i += n)
     {
-      for (unsigned int j = 0; j < size; j++)
-        outptr[j] = values[j] * f;
+      double start, end;
+
+      n = factor_attr_.ramp(num - i, start, end);
+
+      // our output is silent or constant when our input is, and unchanged only with the same factor throughout
+      if (start != lastfactor_  ||  end != lastfactor_)
+        activity &= ~ActivityUnchanged;
 
-      outptr += framesize_;
-      values += framesize_;
+      // zeros stay zeros: nothing to compute
+      if (!silent)
+        PiPoRamp::applyLinear(values + (size_t) i * framesize_, outbuf + (size_t) i * framesize_,
+                              size, framesize_, n, start, (end - start) / n);
+
+      lastfactor_ = end;
     }
 
-    return propagateFrames(time, weight, &buffer_[0], size, num);
+    if (silent  &&  !inplace_)
+      memset(outbuf, 0, num * framesize_ * sizeof(PiPoValue));
+
+    setOutputActivity(activity);
+    return propagateFrames(time, weight, outbuf, size, num);
   }
 };
 
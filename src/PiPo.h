@@ -40,12 +40,17 @@
 
 #include <string>
 #include <vector>
-#include <functional>
 #include <cstring>
-#include <cstdio>
+#include <cassert>
+#include <algorithm>
+#include <cmath>
 
+#ifndef PIPO_LEAN
+#include <functional>
+#include <cstdio>
 #include <typeinfo>
 #include <map>
+#endif
 
 #ifdef WIN32
 #define strcasecmp _stricmp
@@ -62,6 +67,315 @@
 
 typedef float PiPoValue;
 
+#include "PiPoStreamFormat.h"
+
+#if __cplusplus >= 201103L  ||  (defined(_MSVC_LANG)  &&  _MSVC_LANG >= 201103L)
+#define PIPO_HAS_ATOMIC 1
+#include <atomic>
+#endif
+
+#if __cplusplus >= 201103L
+#define PIPO_THREAD_LOCAL thread_local
+#elif defined(_MSC_VER)
+#define PIPO_THREAD_LOCAL __declspec(thread)
+#else
+#define PIPO_THREAD_LOCAL __thread
+#endif
+
+
+/**
+ * Lean build profile
+ *
+ * Defining PIPO_LEAN before including PiPo.h builds the core without RTTI, without printf and with
+ * fixed-capacity receiver, attribute and buffer lists, so that a module does no heap allocation after construction
+ * other than in streamAttributes(), for the buffers it declares and the format conversions of its receivers.
+ * Module code compiles unchanged.
+ * The capacities are small by default, so that the PiPo base of a module stays under 1 kB on 64-bit systems,
+ * and can be raised with PIPO_LEAN_MAX_RECEIVERS, PIPO_LEAN_MAX_ATTRS and PIPO_LEAN_MAX_BUFFERS.
+ *
+ * The lean profile still uses the standard library where the API requires it:
+ * - std::string for the messages of signalError() and signalWarning() and for getAttr() by module and name
+ * - std::vector for the enum lists of enum attributes, variable size attributes and private buffers
+ * - snprintf in PiPoStreamAttributes::to_string() and PiPoDiagnostic::to_string() is left out,
+ *   diagnostics are passed on with their unformatted text
+ */
+#ifdef PIPO_LEAN
+
+#ifndef PIPO_LEAN_MAX_RECEIVERS
+#define PIPO_LEAN_MAX_RECEIVERS 4
+#endif
+
+#ifndef PIPO_LEAN_MAX_ATTRS
+#define PIPO_LEAN_MAX_ATTRS 16
+#endif
+
+#ifndef PIPO_LEAN_MAX_BUFFERS
+#define PIPO_LEAN_MAX_BUFFERS 4
+#endif
+
+/**
+ * unique address per type, replacing typeid()
+ *
+ * The address of the tag is unique within one binary.  Across shared libraries (e.g. a module compiled into
+ * a plugin loaded by a host) each library may have its own copy of a tag, so that attribute types compare
+ * unequal and attributes get the type Undefined.  Build the host and its modules into one binary, or export
+ * the tags with default visibility from a single library, when using the lean profile.
+ */
+template <typename TYPE>
+struct PiPoTypeTag
+{
+  static const char id;
+};
+
+template <typename TYPE>
+const char PiPoTypeTag<TYPE>::id = 0;
+
+typedef char PiPoTypeInfo;
+#define PIPO_TYPEID(TYPE) (&PiPoTypeTag<TYPE>::id)
+
+/** cast of an attribute to its actual class (unchecked) */
+template <typename TARGET, typename SOURCE>
+inline TARGET pipoDowncast (SOURCE *ptr) { return static_cast<TARGET>(ptr); }
+
+#define PIPO_PRINTF(...) ((void) 0)
+
+#else
+
+typedef std::type_info PiPoTypeInfo;
+#define PIPO_TYPEID(TYPE) (&typeid(TYPE))
+
+/** cast of an attribute to its actual class */
+template <typename TARGET, typename SOURCE>
+inline TARGET pipoDowncast (SOURCE *ptr) { return dynamic_cast<TARGET>(ptr); }
+
+#define PIPO_PRINTF(...) printf(__VA_ARGS__)
+
+#endif
+
+/**
+ * Vector of fixed capacity used for the receiver and attribute lists of the lean build profile
+ *
+ * Elements are constructed with the vector.  Adding elements beyond the capacity is a programming error:
+ * it fails an assertion, and push_back() returns false without adding the element in release builds.
+ */
+template <typename TYPE, unsigned int CAPACITY>
+class PiPoFixedVector
+{
+private:
+  TYPE elements_[CAPACITY];
+  unsigned int size_;
+
+public:
+  PiPoFixedVector () : size_(0) { }
+
+  PiPoFixedVector (const PiPoFixedVector &other) : size_(other.size_)
+  {
+    for (unsigned int i = 0; i < size_; i++)
+      elements_[i] = other.elements_[i];
+  }
+
+  PiPoFixedVector &operator= (const PiPoFixedVector &other)
+  {
+    size_ = other.size_;
+
+    for (unsigned int i = 0; i < size_; i++)
+      elements_[i] = other.elements_[i];
+
+    return *this;
+  }
+
+  size_t size () const { return size_; }
+  size_t capacity () const { return CAPACITY; }
+  bool empty () const { return size_ == 0; }
+
+  TYPE &operator[] (size_t i) { return elements_[i]; }
+  const TYPE &operator[] (size_t i) const { return elements_[i]; }
+
+  TYPE *begin () { return elements_; }
+  TYPE *end () { return elements_ + size_; }
+
+  /** add element, returns false when the vector is full */
+  bool push_back (const TYPE &element)
+  {
+    assert(size_ < CAPACITY  &&  "PiPoFixedVector capacity exceeded, increase the PIPO_LEAN_MAX_ capacity");
+
+    if (size_ >= CAPACITY)
+      return false;
+
+    elements_[size_++] = element;
+    return true;
+  }
+
+  void resize (size_t size)
+  {
+    assert(size <= CAPACITY  &&  "PiPoFixedVector capacity exceeded, increase the PIPO_LEAN_MAX_ capacity");
+    size_ = size < CAPACITY  ?  (unsigned int) size  :  CAPACITY;
+  }
+  void clear () { size_ = 0; }
+
+  TYPE *erase (TYPE *position)
+  {
+    for (TYPE *p = position; p + 1 < end(); p++)
+      *p = *(p + 1);
+
+    size_--;
+
+    return position;
+  }
+};
+
+
+/**
+ * Format converter of a receiver, allocated only while its conversion is active
+ *
+ * Most receivers take the output of their sender as it is, so that a module carries a pointer per receiver
+ * instead of a converter with its buffers.  The copy is inactive: the conversions are set up again
+ * when the stream attributes are propagated.
+ */
+class PiPoConverterSlot
+{
+private:
+  PiPoFormatConverter *converter_;
+
+public:
+  PiPoConverterSlot () : converter_(NULL) { }
+  PiPoConverterSlot (const PiPoConverterSlot &other) : converter_(NULL) { }
+  ~PiPoConverterSlot () { delete converter_; }
+
+  PiPoConverterSlot &operator= (const PiPoConverterSlot &other)
+  {
+    if (this != &other)
+    {
+      delete converter_;
+      converter_ = NULL;
+    }
+
+    return *this;
+  }
+
+  /** prepare conversion from \p from to \p to (see PiPoFormatConverter::setup()), releasing the converter when none is needed */
+  void setup (const PiPoStreamFormat &from, const PiPoStreamFormat &to, unsigned int width, unsigned int height, unsigned int maxFrames)
+  {
+    PiPoStreamFormat input = from;
+    PiPoStreamFormat output = to;
+
+    input.resolve(width, height);
+    output.resolve(width, height);
+
+    if (input.satisfies(output))
+    {
+      delete converter_;
+      converter_ = NULL;
+    }
+    else
+    {
+      if (converter_ == NULL)
+        converter_ = new PiPoFormatConverter();
+
+      converter_->setup(from, to, width, height, maxFrames);
+    }
+  }
+
+  bool isActive () const { return converter_ != NULL; }
+
+  /** the converter, valid only while active */
+  PiPoFormatConverter *operator-> () const { return converter_; }
+};
+
+
+/**
+ * Stack of scratch memory for temporaries of PiPo modules (FFT work, sorting...)
+ *
+ * Modules allocate from the arena with PiPo::Scratch during frames(), the memory is released when frames() returns.
+ * A PiPo host binds one arena to each thread executing PiPo graphs with bind(), so that the scratch memory of
+ * all modules of all graphs running on that thread collapses into one region.
+ * The host reserves the arena for the largest scratch size declared by the graphs (see PiPoMemoryPlanner::getScratchSize()).
+ */
+class PiPoScratchArena
+{
+public:
+  /** alignment of scratch allocations */
+  static const size_t alignment = 32;
+
+private:
+  std::vector<char> storage_;
+  char *base_;
+  size_t capacity_;
+  size_t top_;
+
+public:
+  PiPoScratchArena (size_t capacity = 0)
+  : storage_(), base_(NULL), capacity_(0), top_(0)
+  {
+    reserve(capacity);
+  }
+
+  /** the copy is an empty arena of the same capacity */
+  PiPoScratchArena (const PiPoScratchArena &other)
+  : storage_(), base_(NULL), capacity_(0), top_(0)
+  {
+    reserve(other.capacity_);
+  }
+
+  PiPoScratchArena &operator= (const PiPoScratchArena &other)
+  {
+    reserve(other.capacity_);
+    return *this;
+  }
+
+  /** allocate capacity bytes, must not be called while the arena is in use (from the processing thread) */
+  void reserve (size_t capacity)
+  {
+    if (capacity > capacity_)
+    {
+      storage_.resize(capacity + alignment);
+      base_ = &storage_[0] + (alignment - ((size_t) &storage_[0]) % alignment) % alignment;
+      capacity_ = capacity;
+    }
+
+    top_ = 0;
+  }
+
+  size_t getCapacity () const { return capacity_; }
+  size_t getAvailable () const { return capacity_ - top_; }
+
+  /** allocate bytes (aligned) on top of the stack, returns NULL if the arena is exhausted */
+  void *alloc (size_t bytes)
+  {
+    size_t size = (bytes + alignment - 1) / alignment * alignment;
+
+    if (size > capacity_ - top_)
+      return NULL;
+
+    void *ptr = base_ + top_;
+    top_ += size;
+
+    return ptr;
+  }
+
+  size_t mark () const { return top_; }
+  void release (size_t mark) { top_ = mark; }
+
+  /** arena bound to the calling thread, or NULL */
+  static PiPoScratchArena *current ()
+  {
+    return currentRef();
+  }
+
+  /** bind arena to the calling thread (NULL to unbind) */
+  static void bind (PiPoScratchArena *arena)
+  {
+    currentRef() = arena;
+  }
+
+private:
+  static PiPoScratchArena *&currentRef ()
+  {
+    static PIPO_THREAD_LOCAL PiPoScratchArena *arena = NULL;
+    return arena;
+  }
+};
+
 
 struct PiPoStreamAttributes
 {
@@ -76,13 +390,14 @@ struct PiPoStreamAttributes
   unsigned int maxFrames;
   int labels_alloc; //< allocated size of labels, -1 for no (outside) allocation
   int ringTail;
+  PiPoStreamFormat format; //< memory format of the values
 
   PiPoStreamAttributes (int numlabels = -1)
   {
     init(numlabels);
   }
 
-  PiPoStreamAttributes (bool hasTimeTags, double rate, double offset, unsigned int width, unsigned int height, const char **labels, bool hasVarSize, double domain, unsigned int maxFrames, int ringTail = 0)
+  PiPoStreamAttributes (bool hasTimeTags, double rate, double offset, unsigned int width, unsigned int height, const char **labels, bool hasVarSize, double domain, unsigned int maxFrames, int ringTail = 0, const PiPoStreamFormat &format = PiPoStreamFormat())
   {
     this->hasTimeTags = hasTimeTags;
     this->rate    = rate;
@@ -94,6 +409,7 @@ struct PiPoStreamAttributes
     this->domain  = domain;
     this->maxFrames = maxFrames;
     this->ringTail      = ringTail;
+    this->format        = format;
 
     if (labels)
     { // copy label pointers array (but not strings, they're interned symbols!)
@@ -134,7 +450,7 @@ struct PiPoStreamAttributes
 
     if (this != &other) // self-assignment check expected
     {
-      memcpy(this, &other, sizeof(other)); // shallow copy
+      memcpy((void *) this, &other, sizeof(other)); // shallow copy (all members are plain data)
 
       if (other.labels  &&  other.labels_alloc >= 0)
       { // copy label pointers array (but not strings, they're interned symbols!)
@@ -163,6 +479,7 @@ struct PiPoStreamAttributes
     this->domain  = 0.0;
     this->maxFrames = 1;
     this->ringTail      = 0;
+    this->format        = PiPoStreamFormat();
 
     if (_numlab >= 0)
     {
@@ -179,6 +496,56 @@ struct PiPoStreamAttributes
       delete [] labels;
   };
 
+  /**
+   * set all attributes, copying the label pointers (not the strings) into the own labels array, grown as needed
+   */
+  void assign (bool hasTimeTags, double rate, double offset, unsigned int width, unsigned int height, const char **labels, bool hasVarSize, double domain, unsigned int maxFrames)
+  {
+    if (labels != NULL  &&  (int) width > this->labels_alloc)
+    {
+      if (this->labels_alloc >= 0)
+        delete [] this->labels;
+
+      this->labels = new const char *[width];
+      this->labels_alloc = width;
+    }
+
+    this->hasTimeTags = hasTimeTags;
+    this->rate    = rate;
+    this->offset  = offset;
+    this->dims[0] = width;
+    this->dims[1] = height;
+    this->numLabels = labels != NULL  ?  width  :  0;
+    this->hasVarSize  = hasVarSize;
+    this->domain  = domain;
+    this->maxFrames = maxFrames;
+
+    for (unsigned int i = 0; i < this->numLabels; i++)
+      this->labels[i] = labels[i];
+  }
+
+  /**
+   * tell if the given attributes are equal to these, labels are compared by content or by pointer only
+   */
+  bool matches (bool hasTimeTags, double rate, double offset, unsigned int width, unsigned int height, const char **labels, bool hasVarSize, double domain, unsigned int maxFrames, bool labelPointers = false) const
+  {
+    if ((this->hasTimeTags != 0) != hasTimeTags  ||  this->rate != rate  ||  this->offset != offset
+        ||  this->dims[0] != width  ||  this->dims[1] != height  ||  this->hasVarSize != hasVarSize
+        ||  this->domain != domain  ||  this->maxFrames != maxFrames
+        ||  this->numLabels != (labels != NULL  ?  width  :  0))
+      return false;
+
+    for (unsigned int i = 0; i < this->numLabels; i++)
+    {
+      const char *label = this->labels[i];
+
+      if (label != labels[i]  &&  (labelPointers  ||  label == NULL  ||  labels[i] == NULL  ||  std::strcmp(label, labels[i]) != 0))
+        return false;
+    }
+
+    return true;
+  }
+
   /**
    * append string pointer array to labels array
    */
@@ -186,13 +553,13 @@ struct PiPoStreamAttributes
   {
     if (this->labels_alloc < 0)
     {
-      printf("Warning: PiPoStreamAttributes::concat_labels: can't concat %d labels to char ** with %d labels allocated from the outside\n", _width, this->numLabels);
+      PIPO_PRINTF("Warning: PiPoStreamAttributes::concat_labels: can't concat %d labels to char ** with %d labels allocated from the outside\n", _width, this->numLabels);
       _width = 0;
     }
 
     if ((int) (this->numLabels + _width) > this->labels_alloc)
     {
-      printf("Warning: PiPoStreamAttributes::concat_labels: label overflow prevented (trying to concat %d to %d used of %d)\n", _width, this->numLabels, this->labels_alloc);
+      PIPO_PRINTF("Warning: PiPoStreamAttributes::concat_labels: label overflow prevented (trying to concat %d to %d used of %d)\n", _width, this->numLabels, this->labels_alloc);
       _width = this->labels_alloc - this->numLabels;
     }
 
@@ -206,6 +573,7 @@ struct PiPoStreamAttributes
     this->numLabels += _width;
   }
 
+#ifndef PIPO_LEAN
   char *to_string (char *str, int len) const
   {
     snprintf(str, len,
@@ -219,12 +587,105 @@ struct PiPoStreamAttributes
             "hasVarSize\t= %d\n"
             "domain\t\t= %f\n"
             "maxFrames\t= %d\n"
-            "ringTail\t= %d\n",
+            "ringTail\t= %d\n"
+            "valueType\t= %s\n"
+            "layout\t\t= %s\n"
+            "encoding\t= %s\n",
             (int) hasTimeTags, rate, offset, dims[0], dims[1],
             labels && numLabels > 0 && labels[0] != NULL  ?  labels[0]  :  "n/a",
             numLabels, labels_alloc,
-            (int) hasVarSize, domain, maxFrames, ringTail);
+            (int) hasVarSize, domain, maxFrames, ringTail,
+            PiPoStreamFormat::getValueTypeName(format.valueType),
+            PiPoStreamFormat::getLayoutName(format.layout),
+            PiPoStreamFormat::getEncodingName(format.encoding));
+    return str;
+  }
+#endif
+};
+
+
+class PiPo;
+
+#ifndef PIPO_DIAGNOSTIC_TEXT_SIZE
+#define PIPO_DIAGNOSTIC_TEXT_SIZE 96
+#endif
+
+/**
+ * Diagnostic posted by a module to its host (see PiPo::postDiagnostic())
+ *
+ * A diagnostic is a plain record of fixed size that can be posted from frames() without allocation or I/O.
+ * Its message is either a static printf format of up to four double values, formatted only when the host
+ * passes the diagnostic on, or a text copied into the record.
+ */
+struct PiPoDiagnostic
+{
+  enum Severity { Debug, Info, Warning, Error };
+
+  enum Code
+  {
+    Message = 0,      /**< message text only */
+    BadAttribute,     /**< attribute value out of range or inconsistent */
+    BadStream,        /**< input stream not supported by the module */
+    Overflow,         /**< more frames, values or diagnostics than can be held */
+    VersionMismatch,  /**< module built with an older SDK than required */
+    UserCode = 1000   /**< first code free for use by modules */
+  };
+
+  PiPo *pipo;               /**< posting module (NULL for the host) */
+  int code;                 /**< Code or module specific code from UserCode */
+  enum Severity severity;
+  unsigned int count;       /**< number of times the diagnostic was posted in a row (see PiPo::postDiagnostic()) */
+  const char *format;       /**< static printf format of the values, or NULL to use text */
+  double values[4];
+  char text[PIPO_DIAGNOSTIC_TEXT_SIZE];
+
+  PiPoDiagnostic (int code = Message, enum Severity severity = Error, PiPo *pipo = NULL, const char *format = NULL)
+  : pipo(pipo), code(code), severity(severity), count(1), format(format)
+  {
+    this->values[0] = this->values[1] = this->values[2] = this->values[3] = 0;
+    this->text[0] = '\0';
+  }
+
+  /** copy message text, truncated to PIPO_DIAGNOSTIC_TEXT_SIZE - 1 characters */
+  void setText (const char *str)
+  {
+    size_t len = str != NULL  ?  strlen(str)  :  0;
+
+    if (len >= PIPO_DIAGNOSTIC_TEXT_SIZE)
+      len = PIPO_DIAGNOSTIC_TEXT_SIZE - 1;
+
+    memcpy(this->text, str, len);
+    this->text[len] = '\0';
+  }
+
+  static const char *getSeverityName (enum Severity severity)
+  {
+    static const char *names[] = { "debug", "info", "warning", "error" };
+
+    return names[severity];
+  }
+
+  /** message of the diagnostic, formatted into str if needed (to be called by the host, not in real time) */
+  const char *to_string (char *str, int len) const
+  {
+    if (this->format == NULL)
+      return this->text;
+
+#ifndef PIPO_LEAN
+    if (this->count > 1)
+    {
+      int n = snprintf(str, len, "(%u times) ", this->count);
+
+      if (n > 0  &&  n < len)
+        snprintf(str + n, len - n, this->format, this->values[0], this->values[1], this->values[2], this->values[3]);
+    }
+    else
+      snprintf(str, len, this->format, this->values[0], this->values[1], this->values[2], this->values[3]);
+
     return str;
+#else
+    return this->format;
+#endif
   }
 };
 
@@ -256,14 +717,26 @@ The minimal module must derive from the class PiPo and implement at least the \r
 - In \ref streamAttributes, all initialisation can be done, as all input stream parameters (attributes) are known. The output stream parameters are passed on to the receiving module via \ref propagateStreamAttributes.
 - In \ref frames, only data processing and, when needed, buffering should be done.  Output frames are passed on with \ref propagateFrames.
 
+A module doing elementwise processing can write its output over its input when \ref isInputWritable is true, instead of keeping its own output buffer.  A module that does not read its output frames again after \ref propagateFrames should declare this with \ref setOutputWritable, so that its receiver can in turn work in place.
+
+Frame values are interleaved floats by default.  A module can process other value types or planar blocks (see PiPoStreamFormat) by overriding \ref negotiateInputFormat, and produce them by declaring its output format with \ref setOutputFormat.  Where two modules disagree, the values are converted between them.
+
+A block of frames can come with activity flags telling that it is silent, constant, or unchanged since the last block (see \ref getInputActivity).  A module can use them to skip its work, and flags its own output with \ref setOutputActivity.
+
+Attributes can be set by the host from another thread while \ref frames runs.  Scalar attributes are read atomically with get(), and variable size attributes should be read in \ref frames through their get() method, which returns a consistent snapshot of the last published value (see PiPoSnapshot).
+
 If the module can produce additional output data after the end of the input data, it must implement \ref finalize, from within which more calls to \ref propagateFrames can be made, followed by a mandatory call to \ref propagateFinalize.
 
 If the module keeps internal state or buffering, it should implement the \ref reset method to put itself into a clean state.
 
+Hosts often pass the same stream attributes again (e.g. when reconnecting).  A module whose configuration depends only on its input stream attributes and its attributes changing the stream can call \ref setStreamAttributesCache in its constructor, so that \ref streamAttributes is skipped in this case and the module keeps its buffers and their contents.
+
 The utility function \ref signalError can be used to pass an error message to the host.
 
 The utility function \ref signalWarning can be used to pass a warning message to the host.
 
+The utility function \ref postDiagnostic can be used in \ref frames to pass an error code and values to the host without allocation or blocking.
+
 
 \subsection sec_attr Module Attributes or Parameters
 
@@ -273,6 +746,8 @@ The are initialised in the module constructor with a short name, a description,
 
 Their value can be queried in \ref streamAttributes or \ref frames (in real-time hosts, an attributes value can change over time) with PiPo::Attr::get().
 
+Numeric parameters applied to the signal, like a gain factor, can be declared as PiPoSmoothedAttr, so that their changes are ramped over a given time instead of stepping. In \ref frames, the ramp is obtained per block as a value per frame or in linear segments, and applied with the vectorized helpers of PiPoRamp.
+
 \subsection sec_example Example of a Minimal PiPo Module
 
 
@@ -283,6 +758,7 @@ class PiPoGain : public PiPo
 private:
   std::vector<PiPoValue> buffer_;
   unsigned int           framesize_;    // cache max frame size
+  bool                   inplace_;      // write output over input
 
 public:
   PiPoScalarAttr<double> factor_attr_;
@@ -306,8 +782,12 @@ public:
     // we need to store the max frame size in case hasVarSize is true
     framesize_ = width * height; 
 
-    // A general pipo can not work in place, we need to create an output buffer
-    buffer_.resize(framesize_ * maxFrames);
+    // we can work in place if the sender allows to overwrite its output, otherwise we need to create an output buffer
+    inplace_ = isInputWritable();
+    buffer_.resize(inplace_  ?  0  :  framesize_ * maxFrames);
+
+    // either way, we don't read our output again, so the receiver may overwrite it
+    setOutputWritable(true);
 
     // we will produce the same stream layout as the input
     return propagateStreamAttributes(hasTimeTags, rate, offset, width, height,
@@ -318,7 +798,8 @@ public:
               unsigned int size, unsigned int num)
   {
     double     f      = factor_attr_.get(); // get gain factor here, as it could change while running
-    PiPoValue *outptr = &buffer_[0];
+    PiPoValue *outbuf = inplace_  ?  values  :  &buffer_[0];
+    PiPoValue *outptr = outbuf;
 
     for (unsigned int i = 0; i < num; i++)
     {
@@ -329,7 +810,7 @@ public:
       values += framesize_;
     }
 
-    return propagateFrames(time, weight, &buffer_[0], size, num);
+    return propagateFrames(time, weight, outbuf, size, num);
   }
 };
 \endcode
@@ -363,6 +844,54 @@ In summary, a PiPo stream is described by the following attributes:
 public:
   class Attr;
   template<class, std::size_t> class AttrArray; // declare this helper template as PiPo::AttrArray
+  class BufferVisitor;
+
+  /** lifetime of a buffer declared with declareBuffer() */
+  enum BufferLifetime
+  {
+    BufferOutput,     /**< contents are only needed while frames() or finalize() runs (e.g. an output buffer rewritten for every block) */
+    BufferPersistent  /**< contents are kept from one call to the next (e.g. a ring buffer or filter state) */
+  };
+
+  /** activity flags of a block of frames, passed on with the block (see setOutputActivity()) */
+  enum ActivityFlags
+  {
+    ActivityUnknown   = 0, /**< nothing known about the block (the default) */
+    ActivitySilent    = 1, /**< all values are zero (the block is also constant) */
+    ActivityConstant  = 2, /**< all frames of the block are equal */
+    ActivityUnchanged = 4  /**< all frames are equal to the last frame of the previous block (the block is also constant) */
+  };
+
+  /** skipping of streamAttributes() when a module receives the same stream attributes again (see setStreamAttributesCache()) */
+  enum StreamAttributesCache
+  {
+    CacheNone = 0,        /**< streamAttributes() is called for every propagation (the default) */
+    CacheLabelContents,   /**< skipped for unchanged input, labels compared by content */
+    CacheLabelPointers    /**< skipped for unchanged input, labels compared by pointer only */
+  };
+
+  /** buffer declared by a module in streamAttributes() */
+  struct BufferRequest
+  {
+    PiPoValue **slot;           /**< module's pointer to be bound to the buffer memory */
+    size_t numValues;           /**< number of values to reserve */
+    enum BufferLifetime lifetime;
+    bool declared;              /**< declared during the current streamAttributes() round */
+    bool placed;                /**< bound by the planner and not declared again since (the planner keeps its placement and contents) */
+    PiPoAlignedBuffer own;      /**< private storage when the buffer is not placed by a planner */
+  };
+
+#ifdef PIPO_LEAN
+  typedef PiPoFixedVector<PiPo *, PIPO_LEAN_MAX_RECEIVERS> ReceiverList;
+  typedef PiPoFixedVector<Attr *, PIPO_LEAN_MAX_ATTRS> AttrList;
+  typedef PiPoFixedVector<PiPoConverterSlot, PIPO_LEAN_MAX_RECEIVERS> ConverterList;
+  typedef PiPoFixedVector<BufferRequest, PIPO_LEAN_MAX_BUFFERS> BufferList;
+#else
+  typedef std::vector<PiPo *> ReceiverList;
+  typedef std::vector<Attr *> AttrList;
+  typedef std::vector<PiPoConverterSlot> ConverterList;
+  typedef std::vector<BufferRequest> BufferList;
+#endif
 
   /***********************************************
    *
@@ -381,21 +910,67 @@ public:
 
     /** called by pipo to signal warning in parameters */
     virtual void signalWarning(PiPo *pipo, std::string errorMsg) { };
+
+    /**
+     * called by pipo to post a diagnostic, possibly from frames()
+     *
+     * A real-time host should override this to queue the diagnostic without blocking and pass it on from another thread.
+     * The default passes the message on to signalError() or signalWarning().
+     */
+    virtual void postDiagnostic(PiPo *pipo, const PiPoDiagnostic &diagnostic)
+    {
+      char str[256];
+      const char *msg = diagnostic.to_string(str, sizeof(str));
+
+      if (diagnostic.severity == PiPoDiagnostic::Error)
+        signalError(pipo, msg);
+      else
+        signalWarning(pipo, msg);
+    };
   };
 
 protected:
   Parent *parent;
-  std::vector<PiPo *> receivers; /**< list of receivers */
+  ReceiverList receivers; /**< list of receivers */
 
 private:
-  std::vector<Attr *> attrs; /**< list of attributes */
+  AttrList attrs; /**< list of attributes */
+  bool inputWritable;  /**< frames() may overwrite its input values (set by the sender) */
+  bool outputWritable; /**< receivers may overwrite the values passed to propagateFrames() (declared by the module) */
+  unsigned int inputActivity;  /**< activity flags of the block received in frames() (set by the sender) */
+  unsigned int outputActivity; /**< activity flags of the next block passed to propagateFrames() (declared by the module) */
+  PiPoStreamFormat inputFormat;  /**< format of the values received in frames() (set by the sender) */
+  PiPoStreamFormat outputFormat; /**< format of the values passed to propagateFrames() (declared by the module) */
+  ConverterList converters; /**< conversion of output to format of each receiver */
+  bool convertOutput; /**< at least one receiver needs conversion */
+  BufferList buffers; /**< buffers declared by the module */
+  const void *bufferPlanner; /**< memory planner placing the declared buffers, NULL to allocate them privately */
+  size_t scratchSize;       /**< upper bound of scratch memory used in one call to frames() */
+  PiPoScratchArena *scratchArena; /**< arena used when the thread's arena is missing or too small (NULL when the host guarantees it) */
+  PiPoScratchArena ownScratch;    /**< private scratch arena when not planned */
+  int lastDiagnosticCode;         /**< code of the last diagnostic posted, for rate limiting */
+  const void *lastDiagnosticSite; /**< format or text of the last diagnostic posted */
+  unsigned int diagnosticCount;   /**< number of times the last diagnostic was posted in a row */
+  unsigned int attrTransactionDepth; /**< nesting of attribute transactions, changes are held while > 0 */
+  Attr *attrTransactionChange;    /**< last attribute changing the stream set during the transaction */
+  PiPoStreamAttributes lastInputAttrs; /**< input stream attributes of the last call to streamAttributes() (label pointers copied) */
+  bool lastInputKnown;            /**< lastInputAttrs were set by the sender */
+  bool lastInputWritable;         /**< input writability when lastInputAttrs were set */
+  PiPoStreamAttributes lastOutputAttrs; /**< stream attributes last passed to the receivers, kept only for streamAttributesCache (label pointers copied) */
+  bool lastOutputKnown;           /**< lastOutputAttrs were set by the last call to streamAttributes() */
+  enum StreamAttributesCache streamAttributesCache; /**< skipping of streamAttributes() for unchanged input (chosen by the module) */
+  bool streamAttributesDirty;     /**< an attribute changing the stream was set since the last call to streamAttributes() */
 #if __cplusplus >= 201103L  &&  !defined(WIN32)
   constexpr static const float sdk_version = PIPO_SDK_VERSION; /**< pipo SDK version (for inspection) */
 #endif
 
 public:
   PiPo(Parent *parent, PiPo *receiver = NULL)
-  : receivers(), attrs()
+  : receivers(), attrs(), inputWritable(false), outputWritable(false), inputActivity(ActivityUnknown), outputActivity(ActivityUnknown),
+    inputFormat(), outputFormat(), converters(), convertOutput(false), buffers(), bufferPlanner(NULL),
+    scratchSize(0), scratchArena(NULL), ownScratch(), lastDiagnosticCode(-1), lastDiagnosticSite(NULL), diagnosticCount(0),
+    attrTransactionDepth(0), attrTransactionChange(NULL), lastInputAttrs(), lastInputKnown(false),
+    lastInputWritable(false), lastOutputAttrs(), lastOutputKnown(false), streamAttributesCache(CacheNone), streamAttributesDirty(false)
   {
     this->parent = parent;
 
@@ -404,6 +979,11 @@ public:
   }
 
   PiPo(const PiPo &other)
+  : inputWritable(false), outputWritable(false), inputActivity(ActivityUnknown), outputActivity(ActivityUnknown),
+    inputFormat(), outputFormat(), converters(), convertOutput(false), buffers(), bufferPlanner(NULL),
+    scratchSize(0), scratchArena(NULL), ownScratch(), lastDiagnosticCode(-1), lastDiagnosticSite(NULL), diagnosticCount(0),
+    attrTransactionDepth(0), attrTransactionChange(NULL), lastInputAttrs(), lastInputKnown(false),
+    lastInputWritable(false), lastOutputAttrs(), lastOutputKnown(false), streamAttributesCache(other.streamAttributesCache), streamAttributesDirty(false)
   {
     this->parent = other.parent;
   }
@@ -424,10 +1004,8 @@ public:
 #endif
   {
 #if __cplusplus >= 201103L  &&  !defined(WIN32)
-    printf("pipo::getVersion -> %f\n", PiPo::sdk_version);
     return PiPo::sdk_version;
 #else
-    printf("pipo::getVersion -> %f\n", PIPO_SDK_VERSION);
     return PIPO_SDK_VERSION;
 #endif
   }
@@ -496,10 +1074,13 @@ public:
    * PiPo host:
    * A terminating receiver module provided by a PiPo host handles the received frames and usally returns 0.
    *
+   * The values belong to the sender.  A module may only write into them
+   * (i.e. process in place) if isInputWritable() returned true at the last
+   * call to streamAttributes(), otherwise they must be treated as read-only.
+   *
    * @param time        time-tag for a single frame or a block of frames
    * @param weight      weight associated to frame or block
-   * @param values      interleaved frames values, row by row (interleaving channels or columns), frame by frame
-   TODO: should be const!!!
+   * @param values      interleaved frames values, row by row (interleaving channels or columns), frame by frame (writable only if isInputWritable()), of the type, layout and strides given by getInputFormat()
    * @param size        actual number of elements in each frame (number of channels for audio, can differ from width * height for varsize frames!)
    * @param num         number of frames (number of sample framess for audio input)
    * @return            0 for ok or a negative error code (to be specified), -1 for an unspecified error
@@ -507,12 +1088,119 @@ public:
   virtual int frames (double time, double weight, PiPoValue *values, unsigned int size, unsigned int num) = 0;
 
   /**
-   * @brief UNUSED: Signals segment start or end
+   * @brief Processes a block of frames with a time-tag per frame (optional)
+   *
+   * A time-tagged stream (hasTimeTags) with irregular time-tags can be
+   * passed in blocks of frames with this method, where frames() would have
+   * to be called for each frame.
    *
    * PiPo module:
-   * An implementation of this method calls propagateFrames() at the end of the segment.
+   * The default implementation calls frames() for each frame of the block,
+   * so that existing modules work unchanged.  A module that handles blocks
+   * overloads this method and calls propagateFramesTimeTagged(), typically like this:
    *
-   * In the case of two sucessive calls to segment(), the second call implitly ends the last segment.
+   * \code
+   *  return this->propagateFramesTimeTagged(times, weight, values, size, num);
+   * \endcode
+   *
+   * Planar input (see PiPoStreamFormat) can't be split into frames without
+   * copying, the default implementation then passes the whole block with the
+   * first time-tag.
+   *
+   * @param times       array of num time-tags, one for each frame
+   * @param weight      weight associated to the block
+   * @param values      frames values, as for frames()
+   * @param size        actual number of elements in each frame
+   * @param num         number of frames
+   * @return            0 for ok or a negative error code (to be specified), -1 for an unspecified error
+   */
+  virtual int framesTimeTagged (const double *times, double weight, PiPoValue *values, unsigned int size, unsigned int num)
+  {
+    const PiPoStreamFormat &format = this->getInputFormat();
+
+    if(num == 0)
+      return 0;
+
+    if(format.layout == PiPoStreamFormat::Planar)
+      return this->frames(times[0], weight, values, size, num);
+
+    size_t frameBytes = (format.frameStride > 0  ?  format.frameStride  :  size) * format.getValueSize();
+    int ret = -1;
+
+    for(unsigned int i = 0; i < num; i++)
+    {
+      ret = this->frames(times[i], weight, (PiPoValue *) ((char *) values + i * frameBytes), size, 1);
+
+      if(ret < 0)
+        break;
+    }
+
+    return ret;
+  }
+
+  /**
+   * @brief Processes a block of variable size frames, with a size and a time-tag per frame (optional)
+   *
+   * For streams with variable frame size (hasVarSize), where frames() takes
+   * a single size for all frames of a block, frames of different sizes
+   * (e.g. peak lists or segments) can be passed in blocks with this method.
+   * The frames start every frameStride values of the input format (every
+   * width * height values when packed), each with the given number of valid
+   * values, a multiple of the width (i.e. the number of valid rows times the width).
+   *
+   * PiPo module:
+   * The default implementation calls frames() for each frame of the block,
+   * so that existing modules work unchanged.  A module that handles blocks
+   * overloads this method and calls propagateFramesVarSize().
+   *
+   * @param times       array of num time-tags, one for each frame
+   * @param weight      weight associated to the block
+   * @param values      frames values, every frameStride values of the format given by getInputFormat()
+   * @param sizes       array of num sizes, the actual number of elements in each frame
+   * @param num         number of frames
+   * @return            0 for ok or a negative error code (to be specified), -1 for an unspecified error
+   */
+  virtual int framesVarSize (const double *times, double weight, PiPoValue *values, const unsigned int *sizes, unsigned int num)
+  {
+    const PiPoStreamFormat &format = this->getInputFormat();
+    size_t frameStride = format.frameStride;
+    int ret = -1;
+
+    if(num == 0)
+      return 0;
+
+    if(format.layout == PiPoStreamFormat::Planar) // frames can't be split
+      return this->frames(times[0], weight, values, sizes[0], num);
+
+    if(frameStride == 0) // input format not set (e.g. streamAttributes() called directly by the host)
+    {
+      frameStride = this->lastInputAttrs.dims[0] * this->lastInputAttrs.dims[1];
+
+      for(unsigned int i = 0; i < num; i++)
+        if(sizes[i] > frameStride)
+          frameStride = sizes[i];
+    }
+
+    size_t frameBytes = frameStride * format.getValueSize();
+
+    for(unsigned int i = 0; i < num; i++)
+    {
+      ret = this->frames(times[i], weight, (PiPoValue *) ((char *) values + i * frameBytes), sizes[i], 1);
+
+      if(ret < 0)
+        break;
+    }
+
+    return ret;
+  }
+
+  /**
+   * @brief UNUSED: Signals segment start or end
+   *
+   * PiPo module:
+   * An implementation of this method calls propagateFrames() at the end of the segment.
+   *
+   * In the case of two sucessive calls to segment(), the second call implitly ends the last segment.
    *
    * If the module did not receive any frames - at all or since the last segment end -, the method should
    * return 0 to the call segment(0.0, end) without calling propagateFrames().
@@ -578,14 +1266,56 @@ public:
    * @param domain extent of a frame in the given domain (e.g. duration or frequency range)
    * @param maxFrames maximum number of frames in a block exchanged between two modules
    * @return used as return value of the calling method
+   *
+   * The receivers are told whether they may overwrite the frames they will
+   * receive: this is the case only if the module declared its output as
+   * writable by setOutputWritable() and it has a single receiver.
+   *
+   * Each receiver chooses its input format by negotiateInputFormat(), given the
+   * module's output format declared by setOutputFormat().  Where the output doesn't
+   * satisfy the receiver's format (value type, layout, strides or alignment),
+   * propagateFrames() converts the values for that receiver.
+   *
+   * The buffers and scratch memory declared by the module with declareBuffer() and declareScratch()
+   * are allocated here, unless they are placed by a memory planner of the host.
    */
   int propagateStreamAttributes(bool hasTimeTags, double rate, double offset, unsigned int width, unsigned int height, const char **labels, bool hasVarSize, double domain, unsigned int maxFrames)
+  {
+    this->bindBuffers();
+
+    if(this->streamAttributesCache != CacheNone)
+    { // passed again by receiveStreamAttributes() when streamAttributes() is skipped
+      this->lastOutputAttrs.assign(hasTimeTags, rate, offset, width, height, labels, hasVarSize, domain, maxFrames);
+      this->lastOutputKnown = true;
+    }
+
+    return this->passStreamAttributes(hasTimeTags, rate, offset, width, height, labels, hasVarSize, domain, maxFrames);
+  }
+
+private:
+  /** negotiate the receivers' input formats, set up the output conversions, and pass the output stream attributes */
+  int passStreamAttributes(bool hasTimeTags, double rate, double offset, unsigned int width, unsigned int height, const char **labels, bool hasVarSize, double domain, unsigned int maxFrames)
   {
     int ret = 0;
+    bool writable = this->outputWritable  &&  this->receivers.size() == 1;
+
+    PiPoStreamFormat output = this->outputFormat;
+
+    this->converters.resize(this->receivers.size());
+    this->convertOutput = false;
+    output.resolve(width, height);
 
     for(unsigned int i = 0; i < this->receivers.size(); i++)
-    {
-      ret = this->receivers[i]->streamAttributes(hasTimeTags, rate, offset, width, height, labels, hasVarSize, domain, maxFrames);
+    { // let receiver choose its input format, convert where our output doesn't satisfy it
+      PiPoStreamFormat format = output;
+
+      this->receivers[i]->negotiateInputFormat(format);
+      this->converters[i].setup(output, format, width, height, maxFrames);
+      this->convertOutput = this->convertOutput  ||  this->converters[i].isActive();
+
+      this->receivers[i]->setInputFormat(this->converters[i].isActive()  ?  this->converters[i]->getOutputFormat()  :  output);
+      this->receivers[i]->setInputWritable(writable  ||  this->converters[i].isActive()); // converted block is private to the receiver
+      ret = this->receivers[i]->receiveStreamAttributes(hasTimeTags, rate, offset, width, height, labels, hasVarSize, domain, maxFrames);
 
       if(ret < 0)
         break;
@@ -594,6 +1324,106 @@ public:
     return ret;
   }
 
+public:
+  /**
+   * @brief Passes stream attributes to the module (called by the sender instead of streamAttributes())
+   *
+   * propagateStreamAttributes() calls this for each receiver, modules passing their input
+   * on to another module directly (like the head of a sequence) call it on that module.
+   * The input stream attributes are kept for restartStreamAttributes() and, if the module chose
+   * so by setStreamAttributesCache(), streamAttributes() is skipped when they are the same as
+   * the last ones and no attribute changing the stream was set since.  The receivers are then
+   * passed the module's last output stream attributes again, negotiating their formats as propagateStreamAttributes()
+   * does, so that changed or newly attached modules further down are reconfigured.
+   *
+   * @return the return value of streamAttributes()
+   */
+  int receiveStreamAttributes(bool hasTimeTags, double rate, double offset, unsigned int width, unsigned int height, const char **labels, bool hasVarSize, double domain, unsigned int maxFrames)
+  {
+    int ret = 0;
+
+    if(this->isStreamAttributesCached(hasTimeTags, rate, offset, width, height, labels, hasVarSize, domain, maxFrames))
+    { // the output is unchanged, but the receivers may ask for another format
+      const PiPoStreamAttributes &sa = this->lastOutputAttrs;
+
+      if(labels != NULL  &&  this->streamAttributesCache == CacheLabelContents)
+        this->lastInputAttrs.assign(hasTimeTags, rate, offset, width, height, labels, hasVarSize, domain, maxFrames); // keep the sender's current label strings
+
+      return this->passStreamAttributes(sa.hasTimeTags != 0, sa.rate, sa.offset, sa.dims[0], sa.dims[1],
+                                        sa.numLabels > 0  ?  sa.labels  :  NULL, sa.hasVarSize, sa.domain, sa.maxFrames);
+    }
+
+    this->setLastInputAttributes(hasTimeTags, rate, offset, width, height, labels, hasVarSize, domain, maxFrames);
+    this->lastOutputKnown = false;
+    this->streamAttributesDirty = false;
+
+    ret = this->streamAttributes(hasTimeTags, rate, offset, width, height, labels, hasVarSize, domain, maxFrames);
+
+    if(ret < 0)
+      this->streamAttributesDirty = true; // don't skip the next time
+
+    return ret;
+  }
+
+  /**
+   * @brief Keeps the input stream attributes passed to streamAttributes() (called by receiveStreamAttributes())
+   *
+   * The label strings are not copied.
+   */
+  void setLastInputAttributes(bool hasTimeTags, double rate, double offset, unsigned int width, unsigned int height, const char **labels, bool hasVarSize, double domain, unsigned int maxFrames)
+  {
+    this->lastInputAttrs.assign(hasTimeTags, rate, offset, width, height, labels, hasVarSize, domain, maxFrames);
+    this->lastInputAttrs.format = this->inputFormat;
+    this->lastInputWritable = this->inputWritable;
+    this->lastInputKnown = true;
+  }
+
+  /**
+   * @brief Tells if restartStreamAttributes() can reconfigure the module and the following ones alone
+   *
+   * This is the case when the module received stream attributes before and
+   * still accepts its input format (see negotiateInputFormat()).
+   */
+  bool canRestartStreamAttributes(void)
+  {
+    PiPoStreamFormat format = this->inputFormat;
+
+    if(!this->lastInputKnown)
+      return false;
+
+    this->negotiateInputFormat(format);
+    format.resolve(this->lastInputAttrs.dims[0], this->lastInputAttrs.dims[1]);
+
+    return this->inputFormat.satisfies(format);
+  }
+
+  /**
+   * @brief Calls streamAttributes() again with the last input stream attributes (e.g. after an attribute of the module changed)
+   *
+   * Only the module and the modules after it are reconfigured, the modules before it keep their configuration and buffers.
+   * Within a parallel section, the merge has to be told the branch first (see PiPoParallel::restartBranch()).
+   *
+   * @return the return value of streamAttributes(), -1 if the module can't restart
+   */
+  int restartStreamAttributes(void)
+  {
+    const PiPoStreamAttributes &sa = this->lastInputAttrs;
+
+    if(!this->canRestartStreamAttributes())
+      return -1;
+
+    this->lastOutputKnown = false;
+    this->streamAttributesDirty = false;
+
+    int ret = this->streamAttributes(sa.hasTimeTags != 0, sa.rate, sa.offset, sa.dims[0], sa.dims[1],
+                                     sa.numLabels > 0  ?  sa.labels  :  NULL, sa.hasVarSize, sa.domain, sa.maxFrames);
+
+    if(ret < 0)
+      this->streamAttributesDirty = true;
+
+    return ret;
+  }
+
   /**
    * @brief Propagates the reset control event.
    *
@@ -632,6 +1462,14 @@ public:
   {
     int ret = -1;
 
+    this->passActivity();
+
+    if(this->convertOutput)
+      return this->propagateConvertedFrames(time, weight, values, size, num);
+
+    if(this->receivers.size() == 1) // most common case of a sequence, skip the loop
+      return this->receivers[0]->frames(time, weight, values, size, num);
+
     for(unsigned int i = 0; i < this->receivers.size(); i++)
     {
       ret = this->receivers[i]->frames(time, weight, values, size, num);
@@ -643,6 +1481,109 @@ public:
     return ret;
   }
 
+  /**
+   * @brief Propagates a block of time-tagged frames to the receiver.
+   *
+   * This method is called in the framesTimeTagged() method of a PiPo module.
+   *
+   * @return used as return value of the calling method
+   */
+  int propagateFramesTimeTagged(const double *times, double weight, PiPoValue *values, unsigned int size, unsigned int num)
+  {
+    int ret = -1;
+
+    this->passActivity();
+
+    for(unsigned int i = 0; i < this->receivers.size(); i++)
+    {
+      ret = this->propagateFramesTimeTaggedTo(i, times, weight, values, size, num);
+
+      if(ret < 0)
+        break;
+    }
+
+    return ret;
+  }
+
+  /**
+   * @brief Propagates a block of variable size frames to the receiver.
+   *
+   * This method is called in the framesVarSize() method of a PiPo module.
+   *
+   * @return used as return value of the calling method
+   */
+  int propagateFramesVarSize(const double *times, double weight, PiPoValue *values, const unsigned int *sizes, unsigned int num)
+  {
+    int ret = -1;
+
+    this->passActivity();
+
+    for(unsigned int i = 0; i < this->receivers.size(); i++)
+    {
+      ret = this->propagateFramesVarSizeTo(i, times, weight, values, sizes, num);
+
+      if(ret < 0)
+        break;
+    }
+
+    return ret;
+  }
+
+  /**
+   * @brief Propagates a block of time-tagged frames to one receiver, converted to its format
+   *
+   * For modules that pass a block to their receivers one at a time (e.g. PiPoParallel),
+   * after passing the activity flags to all receivers with passActivity().
+   *
+   * @param index  index of the receiver (in the order of setReceiver())
+   * @return used as return value of the calling method
+   */
+  int propagateFramesTimeTaggedTo(unsigned int index, const double *times, double weight, PiPoValue *values, unsigned int size, unsigned int num)
+  {
+    if(this->convertOutput  &&  this->converters[index].isActive())
+    {
+      PiPoValue *out = static_cast<PiPoValue *>(this->converters[index]->convert(values, size, num));
+
+      return this->receivers[index]->framesTimeTagged(times, weight, out, this->converters[index]->getOutputSize(), num);
+    }
+
+    return this->receivers[index]->framesTimeTagged(times, weight, values, size, num);
+  }
+
+  /**
+   * @brief Propagates a block of variable size frames to one receiver, converted to its format
+   *
+   * See propagateFramesTimeTaggedTo().
+   *
+   * @return used as return value of the calling method
+   */
+  int propagateFramesVarSizeTo(unsigned int index, const double *times, double weight, PiPoValue *values, const unsigned int *sizes, unsigned int num)
+  {
+    if(this->convertOutput  &&  this->converters[index].isActive())
+    { // convert the rows of the largest frame in all frames
+      unsigned int maxSize = 0;
+
+      for(unsigned int i = 0; i < num; i++)
+        if(sizes[i] > maxSize)
+          maxSize = sizes[i];
+
+      PiPoValue *out = static_cast<PiPoValue *>(this->converters[index]->convert(values, maxSize, num));
+
+      return this->receivers[index]->framesVarSize(times, weight, out, this->converters[index]->getOutputSizes(sizes), num);
+    }
+
+    return this->receivers[index]->framesVarSize(times, weight, values, sizes, num);
+  }
+
+  /** pass the output activity flags to the receivers for this block only (done by the propagate methods) */
+  void passActivity(void)
+  {
+    for(unsigned int i = 0; i < this->receivers.size(); i++)
+      this->receivers[i]->inputActivity = this->outputActivity;
+
+    this->outputActivity = ActivityUnknown;
+  }
+
   /**
    * @brief Propagates the finalize control event.
    *
@@ -688,8 +1629,8 @@ public:
   {
     if(add)
     {
-      if(receiver != NULL)
-        this->receivers.push_back(receiver);
+      if(receiver != NULL  &&  !appendTo(this->receivers, receiver))
+        this->postDiagnostic(PiPoDiagnostic::Overflow, PiPoDiagnostic::Error, "too many receivers, receiver not added");
     }
     else
     {
@@ -700,12 +1641,451 @@ public:
     }
   }
   
+  /**
+   * @brief Tells a module whether it may overwrite the values it receives in frames() (call only by the sender or the PiPo host)
+   *
+   * This is set before streamAttributes() is called and remains valid until the next call.
+   *
+   * @param writable true if frames() may write its output over its input values
+   */
+  void setInputWritable(bool writable)
+  {
+    this->inputWritable = writable;
+  }
+
+  /**
+   * @brief Queries whether the values received in frames() may be overwritten
+   *
+   * PiPo module:
+   * A module doing elementwise processing can query this in streamAttributes() and, if true,
+   * write its output over its input in frames() instead of allocating an output buffer.
+   *
+   * @return true if the module may process in place
+   */
+  bool isInputWritable(void) const
+  {
+    return this->inputWritable;
+  }
+
+  /**
+   * @brief Declares whether the receivers may overwrite the values passed to propagateFrames()
+   *
+   * PiPo module:
+   * To be called in streamAttributes() before propagateStreamAttributes().
+   * A module may declare its output writable if it does not read the output values again
+   * after propagateFrames() returns, i.e. if they are an output buffer rewritten for every block
+   * or its own input processed in place while isInputWritable() is true.
+   * The default is false, so that modules keeping state in their output buffer are safe.
+   *
+   * @param writable true if the receivers may process the output frames in place
+   */
+  void setOutputWritable(bool writable)
+  {
+    this->outputWritable = writable;
+  }
+
+  bool isOutputWritable(void) const
+  {
+    return this->outputWritable;
+  }
+
+  /**
+   * @brief Lets the module skip streamAttributes() when it receives the same stream attributes again
+   *
+   * PiPo module:
+   * To be called in the constructor by modules whose configuration depends only on their input stream attributes
+   * and their attributes declared as changing the stream.  When the input stream attributes, the input format and writability
+   * are the same as for the last call and no such attribute was set since, streamAttributes() isn't called:
+   * the module keeps its buffers and their contents (a memory planner keeps them in place, or copies them when it reallocates its arena),
+   * and its receivers are passed the module's last output stream attributes again.
+   * CacheLabelPointers is cheaper for long label lists, but only skips when the sender passes the same label strings.
+   * A module passing its input label strings on as output labels has to use CacheLabelPointers.
+   * Modules passing their input on to other modules (sequences, parallel sections, graphs) must not skip.
+   *
+   * @param cache CacheNone (the default), CacheLabelContents, or CacheLabelPointers
+   */
+  void setStreamAttributesCache(enum StreamAttributesCache cache)
+  {
+    this->streamAttributesCache = cache;
+  }
+
+  /**
+   * @brief Tells if receiveStreamAttributes() would skip streamAttributes() for the given input stream attributes
+   */
+  bool isStreamAttributesCached(bool hasTimeTags, double rate, double offset, unsigned int width, unsigned int height, const char **labels, bool hasVarSize, double domain, unsigned int maxFrames) const
+  {
+    if(this->streamAttributesCache == CacheNone  ||  !this->lastInputKnown  ||  this->streamAttributesDirty
+       ||  this->inputWritable != this->lastInputWritable  ||  this->inputFormat != this->lastInputAttrs.format
+       ||  !this->lastInputAttrs.matches(hasTimeTags, rate, offset, width, height, labels, hasVarSize, domain, maxFrames,
+                                         this->streamAttributesCache == CacheLabelPointers))
+      return false;
+
+    return this->lastOutputKnown;
+  }
+
+  /**
+   * @brief Tells a module the activity flags of the next block it receives (call only by the sender or the PiPo host)
+   *
+   * @param activity or-ed ActivityFlags, valid during the next call to frames()
+   */
+  void setInputActivity(unsigned int activity)
+  {
+    this->inputActivity = activity;
+  }
+
+  /**
+   * @brief Queries the activity flags of the block received in frames()
+   *
+   * PiPo module:
+   * A module can skip its work for silent, constant or unchanged input, e.g.
+   * pass on its cached output or compute only one frame of a constant block.
+   * Modules that don't check the flags work as before.
+   *
+   * @return or-ed ActivityFlags, ActivityUnknown if the sender didn't declare any
+   */
+  unsigned int getInputActivity(void) const
+  {
+    return this->inputActivity;
+  }
+
+  /**
+   * @brief Declares the activity flags of the block passed to the next call of propagateFrames()
+   *
+   * PiPo module:
+   * To be called in frames() before propagateFrames(), by modules that know
+   * their output is silent, constant, or unchanged (e.g. because their input
+   * was and the parameters didn't change).  The flags are valid for one block only.
+   *
+   * @param activity or-ed ActivityFlags
+   */
+  void setOutputActivity(unsigned int activity)
+  {
+    this->outputActivity = activity;
+  }
+
+  /**
+   * @brief Detects the activity flags of a block of float frames
+   *
+   * @param values      block of num frames
+   * @param size        number of values of each frame to check
+   * @param num         number of frames
+   * @param frameStride values between the starts of frames
+   * @param last        last frame of the previous block (NULL if unknown)
+   * @return or-ed ActivityFlags
+   */
+  static unsigned int detectActivity(const PiPoValue *values, unsigned int size, unsigned int num, unsigned int frameStride, const PiPoValue *last = NULL)
+  {
+    unsigned int activity = ActivitySilent | ActivityConstant | ActivityUnchanged;
+
+    if(num == 0)
+      return ActivityUnknown;
+
+    if(last == NULL)
+      activity &= ~ActivityUnchanged;
+
+    for(unsigned int j = 0; j < size  &&  activity != ActivityConstant; j++)
+    {
+      if(values[j] != 0.0f)
+        activity &= ~ActivitySilent;
+
+      if(last != NULL  &&  values[j] != last[j])
+        activity &= ~ActivityUnchanged;
+    }
+
+    for(unsigned int i = 1; i < num; i++)
+    {
+      const PiPoValue *frame = values + i * frameStride;
+
+      for(unsigned int j = 0; j < size; j++)
+        if(frame[j] != values[j])
+          return ActivityUnknown;
+    }
+
+    return activity;
+  }
+
+  /**
+   * @brief Chooses the format of the values received in frames() (called by the sender or the PiPo host)
+   *
+   * PiPo module:
+   * Called before streamAttributes() with the output format of the sender.
+   * A module that can process other formats than float values overrides this method and
+   * leaves \p format unchanged if it accepts it, or changes it to the nearest format it accepts.
+   * Where the chosen format differs from the sender's, the values are converted on the edge.
+   * The default implementation accepts only float values (PiPoValue).
+   *
+   * @param format proposed format, to be changed to the accepted format
+   */
+  virtual void negotiateInputFormat(PiPoStreamFormat &format)
+  {
+    format = PiPoStreamFormat();
+  }
+
+  /**
+   * @brief Sets the negotiated format of the values received in frames() (call only by the sender or the PiPo host)
+   */
+  void setInputFormat(const PiPoStreamFormat &format)
+  {
+    this->inputFormat = format;
+  }
+
+  /**
+   * @brief Gets the format of the values received in frames(), as chosen by negotiateInputFormat()
+   */
+  const PiPoStreamFormat &getInputFormat(void) const
+  {
+    return this->inputFormat;
+  }
+
+  /**
+   * @brief Declares the format of the values passed to propagateFrames()
+   *
+   * PiPo module:
+   * To be called in streamAttributes() before propagateStreamAttributes().  The default is packed float values
+   * without guaranteed alignment.  A module declaring an alignment must make sure its output buffer start and
+   * strides respect it (buffers declared with declareBuffer() start at 64 byte boundaries).
+   */
+  void setOutputFormat(const PiPoStreamFormat &format)
+  {
+    this->outputFormat = format;
+  }
+
+  /**
+   * @brief Gets the format the first receiver asks for, given the declared output format
+   *
+   * PiPo module:
+   * To be called in streamAttributes() before allocating the output buffer, so that the module can produce
+   * frames in the receiver's format directly (e.g. padded to its alignment) instead of being converted.
+   *
+   * @return the receiver's format, with strides resolved for frames of width x height values
+   */
+  PiPoStreamFormat getPreferredOutputFormat(unsigned int width, unsigned int height)
+  {
+    PiPoStreamFormat format = this->outputFormat;
+
+    format.resolve(width, height);
+
+    if(this->receivers.size() > 0)
+    {
+      this->receivers[0]->negotiateInputFormat(format);
+      format.resolve(width, height);
+    }
+
+    return format;
+  }
+
+  const PiPoStreamFormat &getOutputFormat(void) const
+  {
+    return this->outputFormat;
+  }
+
+  /**
+   * @brief Declares a buffer needed by the module
+   *
+   * PiPo module:
+   * To be called in streamAttributes() (before propagateStreamAttributes()) for each buffer,
+   * instead of allocating it, typically like this:
+   *
+   * \code
+   *  declareBuffer(buffer_, width * height * maxFrames);
+   * \endcode
+   *
+   * The pointer is bound to the buffer memory when stream attributes propagation is complete.
+   * It is valid from the following call to frames() on, its contents must not be accessed in streamAttributes().
+   * Persistent buffers are cleared to zero, the contents of output buffers are undefined at each call of frames().
+   * A PiPo host can place the buffers of all modules of a graph in a single memory arena (see PiPoMemoryPlanner),
+   * sharing memory between buffers that are never used at the same time.  The buffers of a module whose
+   * streamAttributes() isn't called again keep their contents when the planner places the others.
+   * Buffers that are not declared again on the next call of streamAttributes() are released.
+   *
+   * @param ptr        module's pointer to the buffer (must be a member of the module)
+   * @param numValues  number of values needed
+   * @param lifetime   BufferOutput if the contents are only needed during a call to frames() or finalize(), BufferPersistent otherwise
+   * @return false if the buffer couldn't be declared (more buffers than PIPO_LEAN_MAX_BUFFERS in the lean profile)
+   */
+  bool declareBuffer(PiPoValue *&ptr, size_t numValues, enum BufferLifetime lifetime = BufferOutput)
+  {
+    unsigned int i;
+
+    for(i = 0; i < this->buffers.size(); i++)
+      if(this->buffers[i].slot == &ptr)
+        break;
+
+    if(i == this->buffers.size())
+    {
+      ptr = NULL;
+
+      if(!appendTo(this->buffers, BufferRequest()))
+      {
+        this->postDiagnostic(PiPoDiagnostic::Overflow, PiPoDiagnostic::Error, "too many buffers, buffer not declared");
+        return false;
+      }
+
+      this->buffers[i].slot = &ptr;
+    }
+
+    this->buffers[i].numValues = numValues;
+    this->buffers[i].lifetime = lifetime;
+    this->buffers[i].declared = true;
+    this->buffers[i].placed = false;
+
+    return true;
+  }
+
+  /**
+   * @brief Gets the buffers declared by the module (call only by the PiPo host)
+   */
+  BufferList &getBufferRequests(void)
+  {
+    return this->buffers;
+  }
+
+  /**
+   * @brief Places the declared buffers in memory provided by a memory planner (call only by the PiPo host)
+   *
+   * @param planner planner that binds the buffers by bindBuffer() after stream attributes propagation, NULL to let the module allocate them
+   */
+  void setBufferPlanner(const void *planner)
+  {
+    this->bufferPlanner = planner;
+  }
+
+  const void *getBufferPlanner(void) const
+  {
+    return this->bufferPlanner;
+  }
+
+  /**
+   * @brief Binds a declared buffer to memory provided by the memory planner (call only by the PiPo host)
+   *
+   * @param index index of buffer in getBufferRequests()
+   * @param mem memory for at least numValues values, or NULL to allocate privately
+   */
+  void bindBuffer(unsigned int index, PiPoValue *mem)
+  {
+    BufferRequest &buf = this->buffers[index];
+
+    buf.placed = mem != NULL;
+
+    if(mem != NULL)
+    {
+      buf.own.resize(0); // release private storage
+      *buf.slot = mem;
+    }
+    else
+    { // aligned like the planner's buffers
+      buf.own.resize(buf.numValues * sizeof(PiPoValue));
+
+      if(buf.lifetime == BufferPersistent  &&  buf.numValues > 0)
+        memset(buf.own.data(), 0, buf.numValues * sizeof(PiPoValue));
+
+      *buf.slot = static_cast<PiPoValue *>(buf.own.data());
+    }
+  }
+
+  /**
+   * @brief Declares the scratch memory needed by the module in one call of frames()
+   *
+   * PiPo module:
+   * To be called in streamAttributes() (before propagateStreamAttributes()).
+   * Scratch memory is allocated in frames() with a PiPo::Scratch object,
+   * its contents are lost when frames() returns:
+   *
+   * \code
+   *  // in streamAttributes()
+   *  declareScratch(fftsize * sizeof(float), 1);
+   *
+   *  // in frames()
+   *  Scratch scratch(this);
+   *  float *fftbuf = scratch.alloc<float>(fftsize);
+   * \endcode
+   *
+   * @param bytes     upper bound of the sum of the sizes of the scratch allocations in one call of frames()
+   * @param numAllocs upper bound of the number of allocations (each one is aligned)
+   */
+  void declareScratch(size_t bytes, unsigned int numAllocs = 1)
+  {
+    this->scratchSize = bytes + numAllocs * PiPoScratchArena::alignment;
+  }
+
+  /** @brief Gets the declared scratch size in bytes (call only by the PiPo host) */
+  size_t getScratchSize(void) const
+  {
+    return this->scratchSize;
+  }
+
+  /**
+   * @brief Sets the arena to be used when the thread has no arena bound or it is too small (call only by the PiPo host)
+   *
+   * Called by a memory planner to share one arena among the modules of a graph.
+   *
+   * @param arena fallback arena, NULL if the host guarantees a sufficient arena bound to each processing thread
+   */
+  void setScratchArena(PiPoScratchArena *arena)
+  {
+    this->scratchArena = arena;
+  }
+
+  /**
+   * Scratch memory allocator for use in frames(), releasing the memory on destruction
+   */
+  class Scratch
+  {
+    PiPoScratchArena *arena_;
+    size_t mark_;
+
+  public:
+    Scratch (PiPo *pipo)
+    {
+      arena_ = PiPoScratchArena::current();
+
+      if (arena_ == NULL  ||  arena_->getAvailable() < pipo->scratchSize)
+        arena_ = pipo->scratchArena;
+
+      mark_ = arena_ != NULL  ?  arena_->mark()  :  0;
+    }
+
+    ~Scratch ()
+    {
+      if (arena_ != NULL)
+        arena_->release(mark_);
+    }
+
+    /** allocate bytes, returns NULL if exceeding the declared scratch size */
+    void *alloc (size_t bytes)
+    {
+      return arena_ != NULL  ?  arena_->alloc(bytes)  :  NULL;
+    }
+
+    /** allocate num elements of type T */
+    template<typename T> T *alloc (size_t num)
+    {
+      return static_cast<T *>(alloc(num * sizeof(T)));
+    }
+
+  private:
+    Scratch (const Scratch &other);
+    Scratch &operator= (const Scratch &other);
+  };
+
+  /**
+   * @brief Visits the modules of a graph to collect their buffers (call only by the PiPo host)
+   *
+   * PiPo containers (sequences and parallel sections) visit their modules in the order of processing.
+   */
+  virtual void visitBuffers(BufferVisitor &visitor)
+  {
+    visitor.module(this);
+  }
+
   /** section: internal methods
    */
 
   void streamAttributesChanged(Attr *attr)
   {
-    if(this->parent != NULL)
+    if(this->attrTransactionDepth > 0)
+      this->attrTransactionChange = attr;
+    else if(this->parent != NULL)
       this->parent->streamAttributesChanged(this, attr);
   }
 
@@ -717,7 +2097,7 @@ public:
     if(this->parent != NULL)
       this->parent->signalError(this, errorMsg);
     else
-      printf("PiPo::signalError (not parent): %s\n", errorMsg.c_str());
+      PIPO_PRINTF("PiPo::signalError (not parent): %s\n", errorMsg.c_str());
   }
 
   /**
@@ -728,10 +2108,161 @@ public:
     if(this->parent != NULL)
       this->parent->signalWarning(this, errorMsg);
     else
-      printf("PiPo::signalWarning (not parent): %s\n", errorMsg.c_str());
+      PIPO_PRINTF("PiPo::signalWarning (not parent): %s\n", errorMsg.c_str());
+  }
+
+  /**
+   * Signal error message to be output by the host, without allocation (the message is copied).
+   */
+  void signalError(const char *errorMsg)
+  {
+    PiPoDiagnostic diagnostic(PiPoDiagnostic::Message, PiPoDiagnostic::Error, this);
+
+    diagnostic.setText(errorMsg);
+    passDiagnostic(diagnostic, errorMsg);
+  }
+
+  /**
+   * Signal warning message to be output by the host, without allocation (the message is copied).
+   */
+  void signalWarning(const char *errorMsg)
+  {
+    PiPoDiagnostic diagnostic(PiPoDiagnostic::Message, PiPoDiagnostic::Warning, this);
+
+    diagnostic.setText(errorMsg);
+    passDiagnostic(diagnostic, errorMsg);
+  }
+
+  /**
+   * Post a diagnostic to the host, without allocation or I/O (can be called in frames())
+   *
+   * The format is only used when the host passes the diagnostic on, it must be a static string.
+   * Repetitions of the same diagnostic are rate limited: only the 1st, 2nd, 4th, 8th... in a row are posted,
+   * with the number of repetitions in PiPoDiagnostic::count.
+   *
+   * @param code PiPoDiagnostic::Code or module specific code from PiPoDiagnostic::UserCode
+   * @param severity severity level
+   * @param format printf format of up to four double values
+   */
+  void postDiagnostic(int code, enum PiPoDiagnostic::Severity severity, const char *format,
+                      double v0 = 0, double v1 = 0, double v2 = 0, double v3 = 0)
+  {
+    PiPoDiagnostic diagnostic(code, severity, this, format);
+
+    diagnostic.values[0] = v0;
+    diagnostic.values[1] = v1;
+    diagnostic.values[2] = v2;
+    diagnostic.values[3] = v3;
+    passDiagnostic(diagnostic, format);
+  }
+
+
+
+private:
+  /** add element to a receiver, attribute or buffer list, returns false when a list of the lean profile is full */
+  template <typename LIST, typename TYPE>
+  static bool appendTo(LIST &list, const TYPE &element)
+  {
+#ifdef PIPO_LEAN
+    return list.push_back(element);
+#else
+    list.push_back(element);
+    return true;
+#endif
+  }
+
+  /** pass diagnostic on to the parent, rate limiting repetitions of the same code and message */
+  void passDiagnostic(PiPoDiagnostic &diagnostic, const void *site)
+  {
+    if(diagnostic.code == this->lastDiagnosticCode  &&  site == this->lastDiagnosticSite)
+      this->diagnosticCount++;
+    else
+    {
+      this->lastDiagnosticCode = diagnostic.code;
+      this->lastDiagnosticSite = site;
+      this->diagnosticCount = 1;
+    }
+
+    if((this->diagnosticCount & (this->diagnosticCount - 1)) != 0)
+      return; // not a power of two
+
+    diagnostic.count = this->diagnosticCount;
+
+    if(this->parent != NULL)
+      this->parent->postDiagnostic(this, diagnostic);
+    else
+      PIPO_PRINTF("PiPo::postDiagnostic (not parent): %s\n", diagnostic.format != NULL  ?  diagnostic.format  :  diagnostic.text);
+  }
+
+  /** end of buffer declaration round: release undeclared buffers and allocate if not placed by a planner */
+  /** propagate frames to receivers of which some need converted values */
+  int propagateConvertedFrames(double time, double weight, PiPoValue *values, unsigned int size, unsigned int num)
+  {
+    int ret = -1;
+
+    for(unsigned int i = 0; i < this->receivers.size(); i++)
+    {
+      PiPoValue *out = values;
+      unsigned int outSize = size;
+
+      if(this->converters[i].isActive())
+      {
+        out = static_cast<PiPoValue *>(this->converters[i]->convert(values, size, num));
+        outSize = this->converters[i]->getOutputSize();
+      }
+
+      ret = this->receivers[i]->frames(time, weight, out, outSize, num);
+
+      if(ret < 0)
+        break;
+    }
+
+    return ret;
   }
 
+  void bindBuffers(void)
+  {
+    for(unsigned int i = 0; i < this->buffers.size(); )
+    {
+      if(!this->buffers[i].declared)
+      {
+        *this->buffers[i].slot = NULL;
+        this->buffers.erase(this->buffers.begin() + i);
+      }
+      else
+      {
+        this->buffers[i].declared = false;
+
+        if(this->bufferPlanner == NULL)
+          this->bindBuffer(i, NULL);
+
+        i++;
+      }
+    }
+
+    if(this->bufferPlanner == NULL)
+    { // the planner provides scratch memory, otherwise use a private arena
+      this->ownScratch.reserve(this->scratchSize);
+      this->scratchArena = &this->ownScratch;
+    }
+  }
 
+public:
+  /**
+   * Visitor receiving the modules of a graph in the order of processing, see visitBuffers()
+   *
+   * Modules visited between beginBranch() and endBranch() belong to a branch of a parallel section.
+   * The buffers of a branch are not used anymore when the next branch is processed, except for the
+   * last branch (live), which is still running while the modules following the parallel section process.
+   */
+  class BufferVisitor
+  {
+  public:
+    virtual ~BufferVisitor() { }
+    virtual void module(PiPo *pipo) = 0;
+    virtual void beginBranch(void) { }
+    virtual void endBranch(bool live = false) { }
+  };
 
   /***********************************************
    *
@@ -793,7 +2324,7 @@ public:
     /**
      * PiPo attribute base class
      */
-    Attr(PiPo *pipo, const char *name, const char *descr, const std::type_info *type, bool changesStream, bool isArray = false, bool isVarSize = false)
+    Attr(PiPo *pipo, const char *name, const char *descr, const PiPoTypeInfo *type, bool changesStream, bool isArray = false, bool isVarSize = false)
     {
       this->pipo = pipo;
       this->index = (unsigned int) pipo->attrs.size();
@@ -802,24 +2333,25 @@ public:
       this->isArray = isArray;
       this->isVarSize = isVarSize;
 
-      if(type == &typeid(bool))
+      if(type == PIPO_TYPEID(bool))
         this->type = Bool;
-      else if(type == &typeid(enum Enumerate))
+      else if(type == PIPO_TYPEID(enum Enumerate))
         this->type = Enum;
-      else if(type == &typeid(int))
+      else if(type == PIPO_TYPEID(int))
         this->type = Int;
-      else if(type == &typeid(float))
+      else if(type == PIPO_TYPEID(float))
         this->type = Float;
-      else if(type == &typeid(double))
+      else if(type == PIPO_TYPEID(double))
         this->type = Double;
-      else if(type == &typeid(std::string) || type == &typeid(const char *))
+      else if(type == PIPO_TYPEID(std::string) || type == PIPO_TYPEID(const char *))
         this->type = String;
       else
         this->type = Undefined;
 
       this->changesStream = changesStream;
 
-      pipo->attrs.push_back(this);
+      if(!appendTo(pipo->attrs, this))
+        pipo->postDiagnostic(PiPoDiagnostic::Overflow, PiPoDiagnostic::Error, "too many attributes, attribute not added");
     }
 
     ~Attr(void) { }
@@ -829,6 +2361,7 @@ public:
     void setDescr(const char *descr) { this->descr = descr; }
 
     unsigned int getIndex(void) { return this->index; }
+    PiPo *getPiPo(void) { return this->pipo; }
     const char *getName(void) { return this->name; }
     const char *getDescr(void) { return this->descr; }
     enum Type getType(void) { return this->type; }
@@ -850,7 +2383,98 @@ public:
 
     virtual std::vector<const char *> *getEnumList(void) { return NULL; }
 
-    void changed(bool silently = false) { if (!silently && this->changesStream) this->pipo->streamAttributesChanged(this); }
+    /**
+     * set num values from index i, with a single change notification
+     *
+     * @return true if a value changed
+     */
+    virtual bool setValues(unsigned int i, const int *values, unsigned int num, bool silently = false)
+    {
+      bool change = false;
+
+      for(unsigned int k = 0; k < num; k++)
+      {
+        if(this->isChange(i + k, values[k]))
+        {
+          this->set(i + k, values[k], true);
+          change = true;
+        }
+      }
+
+      if(change)
+        this->changed(silently);
+
+      return change;
+    }
+
+    virtual bool setValues(unsigned int i, const double *values, unsigned int num, bool silently = false)
+    {
+      bool change = false;
+
+      for(unsigned int k = 0; k < num; k++)
+      {
+        if(this->isChange(i + k, values[k]))
+        {
+          this->set(i + k, values[k], true);
+          change = true;
+        }
+      }
+
+      if(change)
+        this->changed(silently);
+
+      return change;
+    }
+
+    /**
+     * set num values from index i silently, on the processing thread of a host applying queued changes
+     *
+     * Variable size attributes change their value in place, without copying it for get() (see PiPoSnapshot::withdraw()),
+     * until the host calls republish().
+     *
+     * @return true if a value changed
+     */
+    virtual bool applyValues(unsigned int i, const int *values, unsigned int num) { return this->setValues(i, values, num, true); }
+    virtual bool applyValues(unsigned int i, const double *values, unsigned int num) { return this->setValues(i, values, num, true); }
+
+    /**
+     * publish the value changed in place by applyValues() again, on the control thread once no queued change to the attribute is pending
+     *
+     * @return false while the processing thread may still read the value changed in place, which the control thread must not change yet
+     */
+    virtual bool republish(void) { return true; }
+
+    /** values of the attribute without copying (getSize() of them), valid until it is set again, NULL if they aren't stored as int */
+    virtual const int *getIntValues(void) { return NULL; }
+
+    /** values of the attribute without copying (getSize() of them), valid until it is set again, NULL if they aren't stored as double */
+    virtual const double *getDblValues(void) { return NULL; }
+
+    void changed(bool silently = false)
+    {
+      if (this->changesStream)
+      {
+        this->pipo->streamAttributesDirty = true;
+
+        if (!silently)
+          this->pipo->streamAttributesChanged(this);
+      }
+    }
+
+    /** tell if setting value i to val would change the attribute (setting a value beyond the size does) */
+    bool isChange(unsigned int i, int val) { return isChange(i, (double) val); }
+    bool isChange(unsigned int i, double val) { return i >= this->getSize()  ||  this->getDbl(i) != val; }
+    bool isChange(unsigned int i, const char *val)
+    {
+      const char *str;
+
+      if(i >= this->getSize())
+        return true;
+
+      str = this->getStr(i);
+
+      return (str == NULL  ||  val == NULL)  ?  str != val  :  strcmp(str, val) != 0;
+    }
     void rename(const char *name) { this->name = name; }
   };
 
@@ -859,29 +2483,35 @@ public:
    */
   class EnumAttr : public Attr
   {
+#ifndef PIPO_LEAN
     struct strCompare : public std::binary_function<const char *, const char *, bool>
     {
       bool operator() (const char *str1, const char *str2) const { return std::strcmp(str1, str2) < 0; }
     };
+#endif
 
     std::vector<const char *>enumList;
     std::vector<const char *>enumListDoc;
+#ifndef PIPO_LEAN
     std::map<const char *, unsigned int, strCompare> enumMap;
+#endif
 
   public:
-    EnumAttr(PiPo *pipo, const char *name, const char *descr, const std::type_info *type, bool changesStream, bool isArray = false, bool isVarSize = false) :
+    EnumAttr(PiPo *pipo, const char *name, const char *descr, const PiPoTypeInfo *type, bool changesStream, bool isArray = false, bool isVarSize = false) :
     Attr(pipo, name, descr, type, changesStream, isArray, isVarSize),
-    enumList(), enumListDoc(), enumMap()
+    enumList(), enumListDoc()
     {
     }
 
     void addEnumItem(const char *item, const char *doc = "undocumented")
     {
+#ifndef PIPO_LEAN
       unsigned int idx = (unsigned int) this->enumList.size();
 
+      this->enumMap[item] = idx;
+#endif
       this->enumList.push_back(item);
       this->enumListDoc.push_back(doc);
-      this->enumMap[item] = idx;
     }
 
     std::vector<const char *> *getEnumList(void)
@@ -891,8 +2521,15 @@ public:
 
     int getEnumIndex(const char *tag)
     {
+#ifndef PIPO_LEAN
       if(tag != NULL && this->enumMap.find(tag) != this->enumMap.end())
         return this->enumMap[tag];
+#else
+      // lean profile: linear search of the (short) enum list
+      for(unsigned int i = 0; tag != NULL && i < this->enumList.size(); i++)
+        if(std::strcmp(this->enumList[i], tag) == 0)
+          return (int) i;
+#endif
 
       return -1;
     }
@@ -919,19 +2556,29 @@ public:
 
   /**
    * @brief Add attribute.
+   *
+   * @return false if the attribute couldn't be added (more attributes than PIPO_LEAN_MAX_ATTRS in the lean profile)
    */
-  void addAttr(PiPo *pipo, const char *name, const char *descr, Attr *attr, bool clear = false)
+  bool addAttr(PiPo *pipo, const char *name, const char *descr, Attr *attr, bool clear = false)
   {
     if(clear)
       this->attrs.clear();
 
+    unsigned int index = (unsigned int) pipo->attrs.size();
+
+    /* add to attr list */
+    if(!appendTo(this->attrs, attr))
+    {
+      this->postDiagnostic(PiPoDiagnostic::Overflow, PiPoDiagnostic::Error, "too many attributes, attribute not added");
+      return false;
+    }
+
     /* overwrite index, name, and description */
-    attr->setIndex((unsigned int) pipo->attrs.size());
+    attr->setIndex(index);
     attr->setName(name);
     attr->setDescr(descr);
 
-    /* add to attr list */
-    this->attrs.push_back(attr);
+    return true;
   }
 
   /**
@@ -982,104 +2629,346 @@ public:
     return getAttr(qname.c_str());
   }
 
-  bool setAttr(unsigned int index, int value, bool silently = false)
+  /**
+   * @brief Starts an attribute transaction
+   *
+   * Attributes set until the matching commitAttrTransaction() don't reconfigure the stream one by one,
+   * the change of stream attributes is passed on once by the commit (e.g. when recalling a preset).
+   * Transactions can be nested, the outermost commit passes on the change.
+   */
+  void beginAttrTransaction(void)
+  {
+    this->attrTransactionDepth++;
+  }
+
+  /**
+   * @brief Ends an attribute transaction
+   *
+   * @param silently drop the change of stream attributes instead of passing it on
+   * @return true if an attribute changing the stream was set in the (outermost) transaction
+   */
+  bool commitAttrTransaction(bool silently = false)
+  {
+    Attr *attr = this->attrTransactionChange;
+
+    if(this->attrTransactionDepth == 0  ||  --this->attrTransactionDepth > 0)
+      return false;
+
+    this->attrTransactionChange = NULL;
+
+    if(attr != NULL  &&  !silently)
+      streamAttributesChanged(attr);
+
+    return attr != NULL;
+  }
+
+  bool setAttr(unsigned int index, int value, bool silently = false)
+  {
+    Attr *attr = getAttr(index);
+
+    if(attr != NULL)
+    {
+      if(attr->isChange(0, value))
+        attr->set(0, value, silently);
+
+      return true;
+    }
+
+    return false;
+  }
+
+  bool setAttr(unsigned int index, const int *values, unsigned int numValues, bool silently = false)
+  {
+    Attr *attr = getAttr(index);
+
+    if(attr != NULL)
+    {
+      attr->setValues(0, values, numValues, silently);
+      return true;
+    }
+
+    return false;
+  }
+
+  bool setAttr(unsigned int index, double val, bool silently = false)
+  {
+    Attr *attr = getAttr(index);
+
+    if(attr != NULL)
+    {
+      if(attr->isChange(0, val))
+        attr->set(0, val, silently);
+
+      return true;
+    }
+
+    return false;
+  }
+
+  bool setAttr(unsigned int index, const double *values, unsigned int numValues, bool silently = false)
+  {
+    Attr *attr = getAttr(index);
+
+    if(attr != NULL)
+    {
+      attr->setValues(0, values, numValues, silently);
+      return true;
+    }
+
+    return false;
+  }
+
+  /**
+   * @brief Gets number of attributes
+   *
+   * @return number of attributes
+   */
+  unsigned int getNumAttrs(void)
+  {
+    return (unsigned int) this->attrs.size();
+  }
+
+  /**
+   * @brief Copies current parent and attributes values
+   *
+   * @param other PiPo to clone
+   */
+  void cloneAttrs(PiPo *other)
+  {
+    for(unsigned int i = 0; i < other->attrs.size(); i++)
+      this->attrs[i]->clone(other->attrs[i]);
+  }
+
+  /**
+   * @brief Copies current value(s) of given attribute
+   *
+   * @param attr attribute to clone from
+   */
+  void cloneAttr(PiPo::Attr *attr)
+  {
+    unsigned int index = attr->getIndex();
+
+    this->attrs[index]->clone(attr);
+  }
+};
+
+
+
+/***********************************************
+ *
+ *  Attribute Storage
+ *
+ */
+
+/**
+ * Value of a scalar attribute, set by a control thread and read by the processing thread
+ *
+ * For the built-in scalar types, the value is atomic when compiled as C++11, so that it can be set while
+ * frames() runs without locking.  Other types are stored as they are.
+ */
+template <typename TYPE>
+class PiPoAtomicValue
+{
+  TYPE value_;
+
+public:
+  PiPoAtomicValue (TYPE value = TYPE()) : value_(value) { }
+
+  TYPE load () const { return value_; }
+  void store (TYPE value) { value_ = value; }
+};
+
+#if PIPO_HAS_ATOMIC
+#define PIPO_ATOMIC_VALUE(TYPE) \
+template <> \
+class PiPoAtomicValue<TYPE> \
+{ \
+  std::atomic<TYPE> value_; \
+\
+public: \
+  PiPoAtomicValue (TYPE value = (TYPE) 0) : value_(value) { } \
+  PiPoAtomicValue (const PiPoAtomicValue &other) : value_(other.load()) { } \
+  PiPoAtomicValue &operator= (const PiPoAtomicValue &other) { store(other.load()); return *this; } \
+\
+  TYPE load () const { return value_.load(std::memory_order_acquire); } \
+  void store (TYPE value) { value_.store(value, std::memory_order_release); } \
+};
+
+PIPO_ATOMIC_VALUE(bool)
+PIPO_ATOMIC_VALUE(int)
+PIPO_ATOMIC_VALUE(unsigned int)
+PIPO_ATOMIC_VALUE(float)
+PIPO_ATOMIC_VALUE(double)
+PIPO_ATOMIC_VALUE(const char *)
+
+#undef PIPO_ATOMIC_VALUE
+#endif
+
+/**
+ * Snapshots of the value of a variable size attribute, published by a control thread to the processing thread
+ *
+ * The control thread changes its own copy of the value and publishes a copy of it with publish().
+ * The processing thread reads the last published copy with get(), which stays valid until its next call to get().
+ * Copies are swapped with an atomic pointer, the copy being read is protected by a hazard pointer,
+ * so that neither side waits for the other.  Copies no longer read are reclaimed (and reused) by publish(),
+ * that is, off the processing thread.  There is one reading thread and one writing thread (or writers
+ * serialized by the host).
+ *
+ * A host applying changes on the processing thread itself (see PiPoHost::setQueueAttrs()) changes
+ * the value in place and calls withdraw() instead of publishing, get() then returns the changed value
+ * without copying nor freeing memory on the processing thread, the withdrawn copy being reclaimed
+ * by the next publish().
+ *
+ * Snapshots need C++11 atomics and heap allocation, without them (or in the lean profile),
+ * get() returns the control thread's copy.
+ */
+#if PIPO_HAS_ATOMIC  &&  !defined(PIPO_LEAN)
+template <typename VALUE>
+class PiPoSnapshot
+{
+  std::atomic<VALUE *> current_;  // last published copy, NULL when withdrawn
+  std::atomic<VALUE *> reading_;  // copy (or live value when withdrawn) in use by the processing thread
+  VALUE *published_;              // last published copy, even when withdrawn (control thread)
+  std::vector<VALUE *> retired_;  // copies replaced, freed when not read anymore
+  VALUE *spare_;                  // reclaimed copy to be reused
+
+public:
+  PiPoSnapshot () : current_(NULL), reading_(NULL), published_(NULL), retired_(), spare_(NULL) { }
+
+  PiPoSnapshot (const PiPoSnapshot &other) : current_(NULL), reading_(NULL), published_(NULL), retired_(), spare_(NULL)
+  {
+    VALUE *value = other.current_.load();
+
+    if (value != NULL)
+    {
+      published_ = new VALUE(*value);
+      current_.store(published_);
+    }
+  }
+
+  PiPoSnapshot &operator= (const PiPoSnapshot &other)
   {
-    Attr *attr = getAttr(index);
+    VALUE *value = other.current_.load();
 
-    if(attr != NULL)
-    {
-      attr->set(0, value, silently);
+    if (value != NULL  &&  this != &other)
+      publish(*value);
 
-      return true;
-    }
+    return *this;
+  }
 
-    return false;
+  ~PiPoSnapshot ()
+  {
+    delete published_;
+    delete spare_;
+
+    for (unsigned int i = 0; i < retired_.size(); i++)
+      delete retired_[i];
   }
 
-  bool setAttr(unsigned int index, int *values, unsigned int numValues, bool silently = false)
+  /** publish a copy of value (control thread) */
+  void publish (const VALUE &value)
   {
-    Attr *attr = getAttr(index);
+    VALUE *next;
 
-    if(attr != NULL)
+    reclaim();
+
+    if (spare_ != NULL)
     {
-      // unused: unsigned int size = (unsigned int) attr->getSize();
+      next = spare_;
+      spare_ = NULL;
+      *next = value;
+    }
+    else
+      next = new VALUE(value);
 
-      for(unsigned int i = 0; i < numValues; i++)
-        attr->set(i, values[i], silently);
+    VALUE *prev = current_.exchange(next);
 
-      return true;
-    }
+    if (prev == NULL)
+      prev = published_; // withdrawn in between
 
-    return false;
+    if (prev != NULL)
+      retired_.push_back(prev);
+
+    published_ = next;
   }
 
-  bool setAttr(unsigned int index, double val, bool silently = false)
+  /** make get() return the live value, changed in place by the processing thread itself (processing thread) */
+  void withdraw ()
   {
-    Attr *attr = getAttr(index);
-
-    if(attr != NULL)
-    {
-      attr->set(0, val, silently);
+    current_.store(NULL);
+  }
 
-      return true;
-    }
+  /** get() returns the live value, which must not be changed until published again (control thread) */
+  bool isWithdrawn () const
+  {
+    return current_.load() == NULL;
+  }
 
-    return false;
+  /** the processing thread may still use the live value returned by get() while withdrawn (control thread) */
+  bool isReadingLive (const VALUE &live) const
+  {
+    return reading_.load() == &live;
   }
 
-  bool setAttr(unsigned int index, double *values, unsigned int numValues, bool silently = false)
+  /** last published copy, or live if none (processing thread) */
+  const VALUE &get (const VALUE &live)
   {
-    Attr *attr = getAttr(index);
+    VALUE *value = current_.load();
 
-    if(attr != NULL)
-    {
-      // unsigned int size = attr->getSize();
+    for (;;)
+    { // announce copy, then check that it wasn't replaced in between
+      reading_.store(value != NULL  ?  value  :  const_cast<VALUE *>(&live));
 
-      for(unsigned int i = 0; i < numValues; i++)
-        attr->set(i, values[i], true);
+      VALUE *check = current_.load();
 
-      attr->changed(silently);
+      if (check == value)
+        break;
 
-      return true;
+      value = check;
     }
 
-    return false;
-  }
-
-  /**
-   * @brief Gets number of attributes
-   *
-   * @return number of attributes
-   */
-  unsigned int getNumAttrs(void)
-  {
-    return (unsigned int) this->attrs.size();
+    return value != NULL  ?  *value  :  live;
   }
 
-  /**
-   * @brief Copies current parent and attributes values
-   *
-   * @param other PiPo to clone
-   */
-  void cloneAttrs(PiPo *other)
+private:
+  void reclaim ()
   {
-    for(unsigned int i = 0; i < other->attrs.size(); i++)
-      this->attrs[i]->clone(other->attrs[i]);
-  }
+    if (published_ != NULL  &&  current_.load() == NULL)
+    { // withdrawn
+      retired_.push_back(published_);
+      published_ = NULL;
+    }
 
-  /**
-   * @brief Copies current value(s) of given attribute
-   *
-   * @param attr attribute to clone from
-   */
-  void cloneAttr(PiPo::Attr *attr)
-  {
-    unsigned int index = attr->getIndex();
+    VALUE *reading = reading_.load();
 
-    this->attrs[index]->clone(attr);
+    for (unsigned int i = 0; i < retired_.size(); )
+    {
+      if (retired_[i] != reading)
+      {
+        if (spare_ == NULL)
+          spare_ = retired_[i];
+        else
+          delete retired_[i];
+
+        retired_.erase(retired_.begin() + i);
+      }
+      else
+        i++;
+    }
   }
 };
-
+#else
+template <typename VALUE>
+class PiPoSnapshot
+{
+public:
+  void publish (const VALUE &value) { }
+  void withdraw () { }
+  bool isWithdrawn () const { return false; }
+  bool isReadingLive (const VALUE &live) const { return false; }
+  const VALUE &get (const VALUE &live) { return live; }
+};
+#endif
 
 
 /***********************************************
@@ -1091,29 +2980,28 @@ template <typename TYPE>
 class PiPoScalarAttr : public PiPo::Attr
 {
 private:
-  TYPE value;
+  PiPoAtomicValue<TYPE> value;
 
 public:
   PiPoScalarAttr(PiPo *pipo, const char *name, const char *descr, bool changesStream, TYPE initVal = (TYPE)0) :
-  Attr(pipo, name, descr, &typeid(TYPE), changesStream)
+  Attr(pipo, name, descr, PIPO_TYPEID(TYPE), changesStream), value(initVal)
   {
-    this->value = initVal;
   }
 
-  void set(TYPE value, bool silently = false) { this->value = value; this->changed(silently); }
-  TYPE get(void) { return this->value; }
+  void set(TYPE value, bool silently = false) { if(value != this->value.load()) { this->value.store(value); this->changed(silently); } }
+  TYPE get(void) { return this->value.load(); }
 
-  void clone(Attr *other) { this->value = (dynamic_cast<PiPoScalarAttr<TYPE> *>(other))->value; }
+  void clone(Attr *other) { this->value.store(pipoDowncast<PiPoScalarAttr<TYPE> *>(other)->get()); }
 
   unsigned int setSize(unsigned int size) { return this->getSize(); }
   unsigned int getSize(void) { return 1; }
 
-  void set(unsigned int i, int val, bool silently = false) { if(i == 0) this->value = (TYPE)val; this->changed(silently); }
-  void set(unsigned int i, double val, bool silently = false) { if(i == 0) this->value = (TYPE)val; this->changed(silently); }
+  void set(unsigned int i, int val, bool silently = false) { if(i == 0) this->value.store((TYPE)val); this->changed(silently); }
+  void set(unsigned int i, double val, bool silently = false) { if(i == 0) this->value.store((TYPE)val); this->changed(silently); }
   void set(unsigned int i, const char *val, bool silently = false) { }
 
-  int getInt(unsigned int i = 0) { return (int)this->value; }
-  double getDbl(unsigned int i = 0) { return (double)this->value; }
+  int getInt(unsigned int i = 0) { return (int)this->value.load(); }
+  double getDbl(unsigned int i = 0) { return (double)this->value.load(); }
   const char *getStr(unsigned int i = 0) { return NULL; }
 };
 
@@ -1121,18 +3009,17 @@ template <>
 class PiPoScalarAttr<const char *> : public PiPo::Attr
 {
 private:
-  const char * value;
+  PiPoAtomicValue<const char *> value;
 
 public:
   PiPoScalarAttr(PiPo *pipo, const char *name, const char *descr, bool changesStream,
 		 const char *initVal = (const char *) 0)
-  : Attr(pipo, name, descr, &typeid(const char *), changesStream)
+  : Attr(pipo, name, descr, PIPO_TYPEID(const char *), changesStream), value(initVal)
   {
-    this->value = initVal;
   }
 
-  void set(const char * value) { this->value = value; }
-  const char *get(void) { return this->value; }
+  void set(const char * value) { this->value.store(value); this->changed(true); }
+  const char *get(void) { return this->value.load(); }
 
   void clone(Attr *other) { *this = *(static_cast<PiPoScalarAttr<const char *> *>(other)); }
 
@@ -1141,42 +3028,41 @@ public:
 
   void set(unsigned int i, int val, bool silently = false) { }
   void set(unsigned int i, double val, bool silently = false) { }
-  void set(unsigned int i, const char *val, bool silently = false) { if(i == 0) this->value = val; this->changed(silently); }
+  void set(unsigned int i, const char *val, bool silently = false) { if(i == 0) this->value.store(val); this->changed(silently); }
 
   int getInt(unsigned int i = 0) { return 0; }
   double getDbl(unsigned int i = 0) { return 0; }
-  const char *getStr(unsigned int i = 0) { return this->value; }
+  const char *getStr(unsigned int i = 0) { return this->value.load(); }
 };
 
 template <>
 class PiPoScalarAttr<enum PiPo::Enumerate> : public PiPo::EnumAttr
 {
 private:
-  unsigned int value;
+  PiPoAtomicValue<unsigned int> value;
 
 public:
   PiPoScalarAttr(PiPo *pipo, const char *name, const char *descr, bool changesStream, unsigned int initVal = 0) :
-  EnumAttr(pipo, name, descr, &typeid(enum PiPo::Enumerate), changesStream)
+  EnumAttr(pipo, name, descr, PIPO_TYPEID(enum PiPo::Enumerate), changesStream), value(initVal)
   {
-    this->value = initVal;
   }
 
-  void set(unsigned int value, bool silently = false) { this->value = clipEnumIndex(value); this->changed(silently); }
-  void set(const char *value, bool silently = false) { this->value = this->getEnumIndex(value); this->changed(silently); }
-  unsigned int get(void) { return this->value; }
+  void set(unsigned int value, bool silently = false) { value = clipEnumIndex(value); if(value != this->value.load()) { this->value.store(value); this->changed(silently); } }
+  void set(const char *value, bool silently = false) { unsigned int index = this->getEnumIndex(value); if(index != this->value.load()) { this->value.store(index); this->changed(silently); } }
+  unsigned int get(void) { return this->value.load(); }
 
-  void clone(Attr *other) { this->value = (dynamic_cast<PiPoScalarAttr<enum PiPo::Enumerate> *>(other))->value; }
+  void clone(Attr *other) { this->value.store(pipoDowncast<PiPoScalarAttr<enum PiPo::Enumerate> *>(other)->get()); }
 
   unsigned int setSize(unsigned int size) { return this->getSize(); }
   unsigned int getSize(void) { return 1; }
 
-  void set(unsigned int i, int val, bool silently = false) { if(i == 0) this->value = clipEnumIndex((unsigned int)val); this->changed(silently); }
-  void set(unsigned int i, double val, bool silently = false) { if(i == 0) this->value = clipEnumIndex((unsigned int)val); this->changed(silently); }
-  void set(unsigned int i, const char *val, bool silently = false) { if(i == 0) this->value = getEnumIndex(val); this->changed(silently); }
+  void set(unsigned int i, int val, bool silently = false) { if(i == 0) this->value.store(clipEnumIndex((unsigned int)val)); this->changed(silently); }
+  void set(unsigned int i, double val, bool silently = false) { if(i == 0) this->value.store(clipEnumIndex((unsigned int)val)); this->changed(silently); }
+  void set(unsigned int i, const char *val, bool silently = false) { if(i == 0) this->value.store(getEnumIndex(val)); this->changed(silently); }
 
-  int getInt(unsigned int i = 0) { return (int)this->value; }
-  double getDbl(unsigned int i = 0) { return (double)this->value; }
-  const char *getStr(unsigned int i = 0) { return this->getEnumTag(this->value); }
+  int getInt(unsigned int i = 0) { return (int)this->value.load(); }
+  double getDbl(unsigned int i = 0) { return (double)this->value.load(); }
+  const char *getStr(unsigned int i = 0) { return this->getEnumTag(this->value.load()); }
 };
 
 
@@ -1218,6 +3104,307 @@ private:
 };
 
 
+/***********************************************
+ *
+ *  Ramps
+ *
+ */
+/**
+ * Block helpers applying a ramp of a parameter over the frames of a block
+ *
+ * Linear ramps go from start by step per frame, exponential ramps approach target by the
+ * coefficient coef per frame (value(i) = target + (start - target) * coef^i).
+ * The values are computed from the frame index rather than accumulated from frame to frame,
+ * so that the loops have no dependency between frames and are vectorized by the compiler.
+ * Frames have size values starting every stride values, out may be the same as in.
+ */
+struct PiPoRamp
+{
+  enum { chunkSize = 64 }; // frames of gains computed at once for frames of several values
+
+  /** write num values of a linear ramp */
+  static void linear (PiPoValue *out, unsigned int num, double start, double step)
+  {
+    float s = (float) start;
+    float d = (float) step;
+
+    for (unsigned int i = 0; i < num; i++)
+      out[i] = s + d * (float) i;
+  }
+
+  /** write num values of an exponential ramp */
+  static void exponential (PiPoValue *out, unsigned int num, double start, double target, double coef)
+  {
+    // powers of coef for a group of lanes, the distance to the target is advanced by coef^lanes per group
+    const unsigned int lanes = 8;
+    float power[lanes];
+    float t = (float) target;
+    double delta = start - target;
+    double p = 1;
+    unsigned int i = 0;
+
+    for (unsigned int k = 0; k < lanes; k++, p *= coef)
+      power[k] = (float) p;
+
+    for (; i + lanes <= num; i += lanes, delta *= p)
+    {
+      float d = (float) delta;
+
+      for (unsigned int k = 0; k < lanes; k++)
+        out[i + k] = t + d * power[k];
+    }
+
+    for (unsigned int k = 0; i < num; i++, k++)
+      out[i] = t + (float) delta * power[k];
+  }
+
+  /** multiply the frames of in by a gain per frame into out */
+  static void apply (const PiPoValue *in, PiPoValue *out, unsigned int size, unsigned int stride, unsigned int num, const PiPoValue *gains)
+  {
+    if (size == 1  &&  stride == 1)
+    {
+      for (unsigned int i = 0; i < num; i++)
+        out[i] = in[i] * gains[i];
+    }
+    else
+    {
+      for (unsigned int i = 0; i < num; i++)
+      {
+        const PiPoValue *frame = in + (size_t) i * stride;
+        PiPoValue *outFrame = out + (size_t) i * stride;
+        PiPoValue g = gains[i];
+
+        for (unsigned int j = 0; j < size; j++)
+          outFrame[j] = frame[j] * g;
+      }
+    }
+  }
+
+  /** multiply the frames of in by a linear ramp into out */
+  static void applyLinear (const PiPoValue *in, PiPoValue *out, unsigned int size, unsigned int stride, unsigned int num, double start, double step)
+  {
+    float s = (float) start;
+    float d = (float) step;
+
+    if (size == 1  &&  stride == 1)
+    {
+      for (unsigned int i = 0; i < num; i++)
+        out[i] = in[i] * (s + d * (float) i);
+    }
+    else
+    {
+      for (unsigned int i = 0; i < num; i++)
+      {
+        const PiPoValue *frame = in + (size_t) i * stride;
+        PiPoValue *outFrame = out + (size_t) i * stride;
+        PiPoValue g = s + d * (float) i;
+
+        for (unsigned int j = 0; j < size; j++)
+          outFrame[j] = frame[j] * g;
+      }
+    }
+  }
+
+  /** multiply the frames of in by an exponential ramp into out */
+  static void applyExponential (const PiPoValue *in, PiPoValue *out, unsigned int size, unsigned int stride, unsigned int num, double start, double target, double coef)
+  {
+    PiPoValue gains[chunkSize];
+    double chunkCoef = std::pow(coef, (double) chunkSize);
+
+    for (unsigned int i = 0; i < num; i += chunkSize, start = target + (start - target) * chunkCoef)
+    {
+      unsigned int n = std::min((unsigned int) chunkSize, num - i);
+
+      exponential(gains, n, start, target, coef);
+      apply(in + (size_t) i * stride, out + (size_t) i * stride, size, stride, n, gains);
+    }
+  }
+};
+
+
+/***********************************************
+ *
+ *  Smoothed Attribute
+ *
+ */
+/**
+ * Double attribute whose changes are smoothed over a ramp time by the processing thread
+ *
+ * A change of the value starts a ramp from the current value to the new one, either linear,
+ * or exponential (reaching -60 dB of the remaining step at the ramp time, then the value).
+ * The module sets the frame rate in streamAttributes() and advances the ramp by the frames of each block in frames(),
+ * either with ramp(num, values), writing a value per frame, or with ramp(num, start, end), passing the ramp on
+ * in linear segments, for example to PiPoRamp::applyLinear():
+ *
+ *   for (unsigned int i = 0, n; i < num; i += n)
+ *   {
+ *     double start, end;
+ *
+ *     n = factor_attr_.ramp(num - i, start, end);
+ *     PiPoRamp::applyLinear(values + i * stride, outbuf + i * stride, size, stride, n, start, (end - start) / n);
+ *   }
+ *
+ * get() returns the value set, the ramp runs in the processing thread only.
+ */
+class PiPoSmoothedAttr : public PiPo::Attr
+{
+public:
+  enum Shape { Linear, Exponential };
+
+private:
+  enum { segmentSize = 32 };  // frames per linear segment of exponential ramps
+
+  PiPoAtomicValue<double> value;     // value set (control thread)
+  PiPoAtomicValue<double> rampTime;  // ramp time in ms
+  PiPoAtomicValue<int> shape;
+  double period;                     // frame period in ms (processing thread)
+  double current;                    // value at the next frame
+  double target;                     // value at the end of the running ramp
+  double step;                       // increment (linear) or coefficient (exponential) per frame
+  enum Shape rampShape;              // shape of the running ramp
+  unsigned int remaining;            // frames left in the running ramp
+
+public:
+  PiPoSmoothedAttr(PiPo *pipo, const char *name, const char *descr, bool changesStream, double initVal = 0,
+                   double rampTime = 0, enum Shape shape = Linear)
+  : Attr(pipo, name, descr, PIPO_TYPEID(double), changesStream), value(initVal), rampTime(rampTime), shape(shape),
+    period(0), current(initVal), target(initVal), step(0), rampShape(shape), remaining(0)
+  {
+  }
+
+  void set(double value, bool silently = false) { if(value != this->value.load()) { this->value.store(value); this->changed(silently); } }
+  double get(void) { return this->value.load(); }
+
+  /** ramp time in ms for the next changes (0 for none) */
+  void setRampTime(double ms) { this->rampTime.store(ms > 0  ?  ms  :  0); }
+  double getRampTime(void) { return this->rampTime.load(); }
+
+  void setShape(enum Shape shape) { this->shape.store(shape); }
+  enum Shape getShape(void) { return (enum Shape) this->shape.load(); }
+
+  /** frame rate of the stream, to be set in streamAttributes() */
+  void setFrameRate(double rate) { this->period = rate > 0  ?  1000.0 / rate  :  0; }
+
+  /** end the running ramp at the value set (e.g. in reset()) */
+  void jump(void)
+  {
+    this->current = this->target = this->value.load();
+    this->remaining = 0;
+  }
+
+  /** value at the next frame */
+  double getCurrent(void) { return this->current; }
+  bool isRamping(void) { return this->remaining > 0  ||  this->value.load() != this->target; }
+
+  /** advance the ramp by num frames, writing the value of each frame to values, returns true if the value changed within the block */
+  bool ramp(unsigned int num, PiPoValue *values)
+  {
+    unsigned int n;
+
+    update();
+    n = std::min(num, this->remaining);
+
+    if (n > 0)
+    {
+      if (this->rampShape == Linear)
+        PiPoRamp::linear(values, n, this->current, this->step);
+      else
+        PiPoRamp::exponential(values, n, this->current, this->target, this->step);
+
+      advance(n);
+    }
+
+    std::fill(values + n, values + num, (PiPoValue) this->current);
+
+    return n > 0;
+  }
+
+  /**
+   * advance the ramp by up to num frames, returns the number of frames n over which the value goes linearly
+   * from start at the first frame to end at the frame after them (start == end when the value is constant),
+   * to be called again for the frames left
+   */
+  unsigned int ramp(unsigned int num, double &start, double &end)
+  {
+    unsigned int n;
+
+    update();
+    start = this->current;
+
+    if (this->remaining == 0)
+    {
+      end = start;
+      return num;
+    }
+
+    n = std::min(num, this->remaining);
+
+    if (this->rampShape == Exponential  &&  n > (unsigned int) segmentSize)
+      n = segmentSize;
+
+    advance(n);
+    end = this->current;
+
+    return n;
+  }
+
+  void clone(Attr *other)
+  {
+    PiPoSmoothedAttr *attr = pipoDowncast<PiPoSmoothedAttr *>(other);
+
+    this->value.store(attr->get());
+    this->rampTime.store(attr->getRampTime());
+    this->shape.store(attr->getShape());
+  }
+
+  unsigned int setSize(unsigned int size) { return this->getSize(); }
+  unsigned int getSize(void) { return 1; }
+
+  void set(unsigned int i, int val, bool silently = false) { if(i == 0) this->value.store((double)val); this->changed(silently); }
+  void set(unsigned int i, double val, bool silently = false) { if(i == 0) this->value.store(val); this->changed(silently); }
+  void set(unsigned int i, const char *val, bool silently = false) { }
+
+  int getInt(unsigned int i = 0) { return (int)this->value.load(); }
+  double getDbl(unsigned int i = 0) { return this->value.load(); }
+  const char *getStr(unsigned int i = 0) { return NULL; }
+
+private:
+  /** start a ramp to a new value set */
+  void update(void)
+  {
+    double next = this->value.load();
+
+    if (next != this->target)
+    {
+      double frames = this->period > 0  ?  this->rampTime.load() / this->period  :  0;
+
+      this->target = next;
+      this->rampShape = (enum Shape) this->shape.load();
+      this->remaining = frames >= 1  ?  (unsigned int) (frames + 0.5)  :  0;
+
+      if (this->remaining == 0)
+        this->current = next;
+      else if (this->rampShape == Linear)
+        this->step = (next - this->current) / this->remaining;
+      else
+        this->step = std::pow(0.001, 1.0 / this->remaining);
+    }
+  }
+
+  void advance(unsigned int n)
+  {
+    this->remaining -= n;
+
+    if (this->remaining == 0)
+      this->current = this->target;
+    else if (this->rampShape == Linear)
+      this->current += n * this->step;
+    else
+      this->current = this->target + (this->current - this->target) * std::pow(this->step, (double) n);
+  }
+};
+
+
 /***********************************************
  *
  *  Fixed Size Array Attribute
@@ -1240,13 +3427,13 @@ class PiPoArrayAttr : public PiPo::Attr, public PiPo::AttrArray<TYPE, SIZE>
 {
 public:
   PiPoArrayAttr(PiPo *pipo, const char *name, const char *descr, bool changesStream, TYPE initVal = (TYPE)0) :
-  Attr(pipo, name, descr, &typeid(TYPE), changesStream, true, false),
+  Attr(pipo, name, descr, PIPO_TYPEID(TYPE), changesStream, true, false),
   PiPo::AttrArray<TYPE, SIZE>()
   {
     for(unsigned int i = 0; i < SIZE; i++)
       (*this)[i] = initVal;
   }
-  void clone(Attr *other) { *(dynamic_cast<PiPo::AttrArray<TYPE, SIZE> *>(this)) = *(dynamic_cast<PiPo::AttrArray<TYPE, SIZE> *>(other)); }
+  void clone(Attr *other) { static_cast<PiPo::AttrArray<TYPE, SIZE> &>(*this) = *pipoDowncast<PiPoArrayAttr<TYPE, SIZE> *>(other); }
 
   unsigned int setSize(unsigned int size) { return this->getSize(); }
   unsigned int getSize(void) { return SIZE; }
@@ -1299,7 +3486,7 @@ class PiPoArrayAttr<enum PiPo::Enumerate, SIZE> : public PiPo::EnumAttr, public
 {
 public:
   PiPoArrayAttr(PiPo *pipo, const char *name, const char *descr, bool changesStream, unsigned int initVal = 0) :
-  EnumAttr(pipo, name, descr, &typeid(enum PiPo::Enumerate), changesStream, true, false),
+  EnumAttr(pipo, name, descr, PIPO_TYPEID(enum PiPo::Enumerate), changesStream, true, false),
   PiPo::AttrArray<unsigned int, SIZE>()
   {
     for(unsigned int i = 0; i < this->size; i++)
@@ -1308,7 +3495,7 @@ public:
 
   ~PiPoArrayAttr(void) { free(this->value); }
 
-  void clone(Attr *other) { *(dynamic_cast<PiPo::AttrArray<unsigned int, SIZE> *>(this)) = *(dynamic_cast<PiPo::AttrArray<unsigned int, SIZE> *>(other)); }
+  void clone(Attr *other) { static_cast<PiPo::AttrArray<unsigned int, SIZE> &>(*this) = *pipoDowncast<PiPoArrayAttr<enum PiPo::Enumerate, SIZE> *>(other); }
 
   unsigned int setSize(unsigned int size) { return this->getSize(); }
   unsigned int getSize(void) { return SIZE; }
@@ -1367,21 +3554,87 @@ public:
  *  Var Size Attribute
  *
  */
+/** pointer to the values of a vector if they are stored as TO, NULL otherwise */
+template <typename TO, typename FROM>
+struct PiPoValuesAs
+{
+  static const TO *get(const std::vector<FROM> &vec) { return NULL; }
+};
+
+template <typename TO>
+struct PiPoValuesAs<TO, TO>
+{
+  static const TO *get(const std::vector<TO> &vec) { return vec.empty()  ?  NULL  :  &vec[0]; }
+};
+
 template <typename TYPE>
 class PiPoVarSizeAttr : public PiPo::Attr, public std::vector<TYPE>
 {
+private:
+  PiPoSnapshot<std::vector<TYPE> > snapshot_;
+
+  template <typename VALUE>
+  bool assignValues(unsigned int i, const VALUE *values, unsigned int num, bool silently, bool inPlace = false)
+  { // publish once for all values (or withdraw the published copy when changed in place by the processing thread)
+    bool change = false;
+
+    if (i + num > this->size())
+    {
+      this->resize(i + num, (TYPE)0);
+      change = true;
+    }
+
+    for (unsigned int k = 0; k < num; k++)
+    {
+      TYPE val = static_cast<TYPE>(values[k]);
+
+      if ((*this)[i + k] != val)
+      {
+        (*this)[i + k] = val;
+        change = true;
+      }
+    }
+
+    if (change)
+    {
+      if (inPlace)
+        this->snapshot_.withdraw();
+      else
+        this->publish();
+
+      this->changed(silently);
+    }
+
+    return change;
+  }
+
 public:
   PiPoVarSizeAttr(PiPo *pipo, const char *name, const char *descr, bool changesStream, unsigned int size = 0, TYPE initVal = (TYPE)0) :
-  Attr(pipo, name, descr, &typeid(TYPE), changesStream, false, true),
+  Attr(pipo, name, descr, PIPO_TYPEID(TYPE), changesStream, false, true),
   std::vector<TYPE>(size, initVal)
   {
+    this->publish();
   }
 
-  void clone(Attr *other) { *(dynamic_cast<std::vector<TYPE> *>(this)) = *(dynamic_cast<std::vector<TYPE> *>(other)); }
+  void clone(Attr *other) { static_cast<std::vector<TYPE> &>(*this) = *pipoDowncast<PiPoVarSizeAttr<TYPE> *>(other); this->publish(); }
 
-  unsigned int setSize(unsigned int size) { this->resize(size, (TYPE)0); return size; }
+  unsigned int setSize(unsigned int size) { this->resize(size, (TYPE)0); this->publish(); return size; }
   unsigned int getSize(void) { return (unsigned int) this->size(); }
 
+  /** publish the value to the processing thread, to be called after changing the vector directly */
+  void publish() { this->snapshot_.publish(*this); }
+
+  /** consistent snapshot of the value for the processing thread (see PiPoSnapshot) */
+  const std::vector<TYPE> &get() { return this->snapshot_.get(*this); }
+
+  bool republish(void)
+  {
+    if (this->snapshot_.isWithdrawn())
+      this->publish();
+
+    return !this->snapshot_.isReadingLive(*this);
+  }
+
   void set(unsigned int i, int val, bool silently = false)
   {
     if (i >= this->size())
@@ -1389,6 +3642,7 @@ public:
 
     (*this)[i] = (TYPE)val;
 
+    this->publish();
     this->changed(silently);
   }
 
@@ -1399,6 +3653,7 @@ public:
 
     (*this)[i] = static_cast<TYPE>(val);
 
+    this->publish();
     this->changed(silently);
   }
 
@@ -1423,6 +3678,14 @@ public:
 
   const char *getStr(unsigned int i) { return NULL; }
 
+  bool setValues(unsigned int i, const int *values, unsigned int num, bool silently = false) { return this->assignValues(i, values, num, silently); }
+  bool setValues(unsigned int i, const double *values, unsigned int num, bool silently = false) { return this->assignValues(i, values, num, silently); }
+  bool applyValues(unsigned int i, const int *values, unsigned int num) { return this->assignValues(i, values, num, true, true); }
+  bool applyValues(unsigned int i, const double *values, unsigned int num) { return this->assignValues(i, values, num, true, true); }
+
+  const int *getIntValues(void) { return PiPoValuesAs<int, TYPE>::get(*this); }
+  const double *getDblValues(void) { return PiPoValuesAs<double, TYPE>::get(*this); }
+
   TYPE *getPtr()  // return pointer to first data element
   {
     return &((*this)[0]);
@@ -1434,20 +3697,31 @@ public:
 template <>
 class PiPoVarSizeAttr<const char *> : public PiPo::Attr, public std::vector<const char *>
 {
+private:
+  PiPoSnapshot<std::vector<const char *> > snapshot_;
+
 public:
   PiPoVarSizeAttr(PiPo *pipo, const char *name, const char *descr, bool changesStream, unsigned int size = 0, const char *initVal = 0) :
-  Attr(pipo, name, descr, &typeid(const char *), changesStream, false, true),
+  Attr(pipo, name, descr, PIPO_TYPEID(const char *), changesStream, false, true),
   std::vector<const char *>(size, initVal)
   {
     for(unsigned int i = 0; i < this->size(); i++)
       (*this)[i] = initVal;
+
+    this->publish();
   }
 
-  void clone(Attr *other) { *(dynamic_cast<std::vector<const char *> *>(this)) = *(dynamic_cast<std::vector<const char *> *>(other)); }
+  void clone(Attr *other) { static_cast<std::vector<const char *> &>(*this) = *pipoDowncast<PiPoVarSizeAttr<const char *> *>(other); this->publish(); }
 
-  unsigned int setSize(unsigned int size) { this->resize(size, 0); return size; }
+  unsigned int setSize(unsigned int size) { this->resize(size, 0); this->publish(); return size; }
   unsigned int getSize(void) { return (unsigned int) this->size(); }
 
+  /** publish the value to the processing thread, to be called after changing the vector directly */
+  void publish() { this->snapshot_.publish(*this); }
+
+  /** consistent snapshot of the value for the processing thread (see PiPoSnapshot) */
+  const std::vector<const char *> &get() { return this->snapshot_.get(*this); }
+
   void set(unsigned int i, int val, bool silently = false)
   {
     if (i >= this->size())
@@ -1455,6 +3729,7 @@ public:
 
     (*this)[i] = NULL; // todo: itoa
 
+    this->publish();
     this->changed(silently);
   }
 
@@ -1465,6 +3740,7 @@ public:
 
     (*this)[i] = NULL; // todo: ftoa
 
+    this->publish();
     this->changed(silently);
   }
 
@@ -1475,6 +3751,7 @@ public:
 
     (*this)[i] = val;
 
+    this->publish();
     this->changed(silently);
   }
 
@@ -1508,20 +3785,31 @@ public:
 template <>
 class PiPoVarSizeAttr<enum PiPo::Enumerate> : public PiPo::EnumAttr, public std::vector<unsigned int>
 {
+private:
+  PiPoSnapshot<std::vector<unsigned int> > snapshot_;
+
 public:
   PiPoVarSizeAttr(PiPo *pipo, const char *name, const char *descr, bool changesStream, unsigned int size = 0, unsigned int initVal = 0) :
-  EnumAttr(pipo, name, descr, &typeid(enum PiPo::Enumerate), changesStream, false, true),
+  EnumAttr(pipo, name, descr, PIPO_TYPEID(enum PiPo::Enumerate), changesStream, false, true),
   std::vector<unsigned int>(size, 0)
   {
     for(unsigned int i = 0; i < this->size(); i++)
       (*this)[i] = initVal;
+
+    this->publish();
   }
 
-  void clone(Attr *other) { *(dynamic_cast<std::vector<unsigned int> *>(this)) = *(dynamic_cast<std::vector<unsigned int> *>(other)); }
+  void clone(Attr *other) { static_cast<std::vector<unsigned int> &>(*this) = *pipoDowncast<PiPoVarSizeAttr<enum PiPo::Enumerate> *>(other); this->publish(); }
 
-  unsigned int setSize(unsigned int size) { this->resize(size, 0); return size; }
+  unsigned int setSize(unsigned int size) { this->resize(size, 0); this->publish(); return size; }
   unsigned int getSize(void) { return (unsigned int) this->size(); }
 
+  /** publish the value to the processing thread, to be called after changing the vector directly */
+  void publish() { this->snapshot_.publish(*this); }
+
+  /** consistent snapshot of the value for the processing thread (see PiPoSnapshot) */
+  const std::vector<unsigned int> &get() { return this->snapshot_.get(*this); }
+
   void set(unsigned int i, int val, bool silently = false)
   {
     if (i >= this->size())
@@ -1529,6 +3817,7 @@ public:
 
     (*this)[i] = (unsigned int)val;
 
+    this->publish();
     this->changed(silently);
   }
 
@@ -1539,6 +3828,7 @@ public:
 
     (*this)[i] = (unsigned int)val;
 
+    this->publish();
     this->changed(silently);
   }
 
@@ -1549,6 +3839,7 @@ public:
 
     (*this)[i] = getEnumIndex(val);
 
+    this->publish();
     this->changed(silently);
   }
 
@@ -1582,19 +3873,30 @@ public:
 template <>
 class PiPoVarSizeAttr<PiPo::Atom> : public PiPo::Attr, public std::vector<PiPo::Atom>
 {
+private:
+  PiPoSnapshot<std::vector<PiPo::Atom> > snapshot_;
+
 public:
     PiPoVarSizeAttr(PiPo *pipo, const char *name, const char *descr, bool changesStream, unsigned int size = 0, int initVal = 0) :
-    Attr(pipo, name, descr, &typeid(const char *), changesStream, false, true)
+    Attr(pipo, name, descr, PIPO_TYPEID(const char *), changesStream, false, true)
     {
         for(unsigned int i = 0; i < this->size(); i++)
             (*this)[i] = PiPo::Atom(initVal);
+
+        this->publish();
     }
 
-    void clone(Attr *other) { *(dynamic_cast<std::vector<PiPo::Atom> *>(this)) = *(dynamic_cast<std::vector<PiPo::Atom> *>(other)); }
+    void clone(Attr *other) { static_cast<std::vector<PiPo::Atom> &>(*this) = *pipoDowncast<PiPoVarSizeAttr<PiPo::Atom> *>(other); this->publish(); }
 
-    unsigned int setSize(unsigned int size) { this->resize(size, PiPo::Atom(0)); return size; }
+    unsigned int setSize(unsigned int size) { this->resize(size, PiPo::Atom(0)); this->publish(); return size; }
     unsigned int getSize(void) { return (unsigned int) this->size(); }
 
+    /** publish the value to the processing thread, to be called after changing the vector directly */
+    void publish() { this->snapshot_.publish(*this); }
+
+    /** consistent snapshot of the value for the processing thread (see PiPoSnapshot) */
+    const std::vector<PiPo::Atom> &get() { return this->snapshot_.get(*this); }
+
     void set(unsigned int i, int val, bool silently = false)
     {
       if (i >= this->size())
@@ -1602,6 +3904,7 @@ public:
 
       (*this)[i] = PiPo::Atom(val);
 
+      this->publish();
       this->changed(silently);
     }
 
@@ -1612,6 +3915,7 @@ public:
 
       (*this)[i] = PiPo::Atom(val);
 
+      this->publish();
       this->changed(silently);
     }
 
@@ -1622,6 +3926,7 @@ public:
 
       (*this)[i] = PiPo::Atom(val);
 
+      this->publish();
       this->changed(silently);
     }
 
@@ -44,20 +44,36 @@ private:
 #   define		 MAX_PAR 64
     int			 count_;
     int			 numpar_;
+    bool		 restart_;	// stream attributes come from branch count_ only (see restart())
     PiPoStreamAttributes sa_;	// combined stream attributes
+    PiPoStreamAttributes parsa_[MAX_PAR]; // last stream attributes of parallel pipos
     int			 paroffset_[MAX_PAR]; // cumulative column offsets in output array
     int			 parwidth_[MAX_PAR];  // column widths of parallel pipos
+    unsigned int	 parrowstride_[MAX_PAR];   // input row strides of parallel pipos (views are merged without packing)
+    unsigned int	 parframestride_[MAX_PAR]; // input frame strides of parallel pipos
+    bool		 parsparse_[MAX_PAR];      // parallel pipo passes sparse frames (scattered directly into values_)
     int			 framesize_;		// output frame size = width * maxheight
+    unsigned int	 rowstride_;		// values between rows in values_ (padded to receiver's alignment)
+    unsigned int	 framestride_;		// values between frames in values_
 
     // working variables for merging of frames
     PiPoValue		*values_;
-    int			 time_;
+    double		 time_;
     unsigned int	 numrows_;
     unsigned int	 numframes_;
+    unsigned int	 activity_;	// activity flags common to all parallel pipos' blocks
+
+    // merging of time-tagged and varsize blocks, passed on as one block (see beginBlock())
+    bool		 block_;	// collecting the frames of each branch for a block
+    int			 branch_;	// branch passing its frames
+    unsigned int	 branchframes_;	// frames received from branch_
+    std::vector<double>	 times_;	// time-tags of the merged frames (from the first branch)
+    std::vector<unsigned int> rows_;	// rows of the merged frames (from the first branch), then their sizes
 
   public:
     PiPoMerge (PiPo::Parent *parent)
-    : PiPo(parent), count_(0), numpar_(0), sa_(1024), framesize_(0), values_(NULL)
+    : PiPo(parent), count_(0), numpar_(0), restart_(false), sa_(1024), framesize_(0), rowstride_(0), framestride_(0), values_(NULL), activity_(0),
+      block_(false), branch_(0), branchframes_(0), times_(), rows_()
     {
 #ifdef DEBUG	// clean memory to make possible memory errors more consistent at least
       memset(paroffset_, 0, sizeof(*paroffset_) * MAX_PAR);
@@ -65,9 +81,11 @@ private:
 #endif
     }
 
-    // copy constructor
+    // copy constructor (the merge buffer is declared again in streamAttributes)
     PiPoMerge (const PiPoMerge &other)
-    : PiPo(other.parent), count_(other.count_), numpar_(other.numpar_), sa_(other.sa_), framesize_(other.framesize_)
+    : PiPo(other.parent), count_(other.count_), numpar_(other.numpar_), restart_(false), sa_(other.sa_), framesize_(other.framesize_),
+      rowstride_(other.rowstride_), framestride_(other.framestride_), values_(NULL), activity_(0),
+      block_(false), branch_(0), branchframes_(0), times_(other.times_), rows_(other.rows_)
     {
 #if defined(__GNUC__) &&  PIPO_DEBUG >= 2
       printf("\n•••••• %s: COPY CONSTRUCTOR\n", __PRETTY_FUNCTION__); //db
@@ -80,8 +98,10 @@ private:
 
       memcpy(paroffset_, other.paroffset_, numpar_ * sizeof(int));
       memcpy(parwidth_, other.parwidth_, numpar_ * sizeof(int));
-      values_ = (PiPoValue *) malloc(sa_.maxFrames * framesize_ * sizeof(PiPoValue));
-      memcpy(values_, other.values_, sa_.maxFrames * framesize_ * sizeof(PiPoValue));
+      memcpy(parrowstride_, other.parrowstride_, numpar_ * sizeof(unsigned int));
+      memcpy(parframestride_, other.parframestride_, numpar_ * sizeof(unsigned int));
+      memcpy(parsparse_, other.parsparse_, numpar_ * sizeof(bool));
+      copyBranchAttributes(other);
     }
 
     // assignment operator
@@ -100,20 +120,24 @@ private:
       numpar_    = other.numpar_;
       sa_        = other.sa_;
       framesize_ = other.framesize_;
+      rowstride_ = other.rowstride_;
+      framestride_ = other.framestride_;
+      times_     = other.times_;
+      rows_      = other.rows_;
       
       memcpy(paroffset_, other.paroffset_, numpar_ * sizeof(int));
       memcpy(parwidth_, other.parwidth_, numpar_ * sizeof(int));
-      values_ = (PiPoValue *) malloc(sa_.maxFrames * framesize_ * sizeof(PiPoValue));
-      memcpy(values_, other.values_, sa_.maxFrames * framesize_ * sizeof(PiPoValue));
+      memcpy(parrowstride_, other.parrowstride_, numpar_ * sizeof(unsigned int));
+      memcpy(parframestride_, other.parframestride_, numpar_ * sizeof(unsigned int));
+      memcpy(parsparse_, other.parsparse_, numpar_ * sizeof(bool));
+      copyBranchAttributes(other);
 
       return *this;
     }
 
-    // destructor
+    // destructor (merge buffer is owned by PiPo base class)
     ~PiPoMerge ()
-    {
-      free(values_);
-    }
+    { }
 
   public:
     void start (size_t numpar)
@@ -122,12 +146,70 @@ private:
       count_  = 0;
     }
 
+    void restart (unsigned int branch)
+    { // on restart of the stream attributes propagation within one branch, expect only its call, combined with the other branches' last stream attributes
+      count_   = (int) branch;
+      restart_ = true;
+    }
+
 // TODO: signal end of parallel pipos, accomodates for possibly missing calls down the chain
     void finish ()
     {
     }
 
+    /** collect the frames each branch passes for one time-tagged or varsize block, in any number of calls,
+        between beginBranch() calls, to be passed on as one block by endBlock() */
+    void beginBlock (size_t numpar)
+    {
+      start(numpar);
+      block_     = true;
+      numframes_ = 0;
+      activity_  = ActivityUnknown;
+    }
+
+    void beginBranch (unsigned int branch)
+    {
+      branch_       = (int) branch;
+      branchframes_ = 0;
+    }
+
+    int endBlock (bool varsize)
+    {
+      block_ = false;
+      count_ = numpar_;
+
+      if (numframes_ == 0)
+	return 0;
+
+      setOutputActivity(activity_);
+
+      if (varsize)
+      {
+	for (unsigned int i = 0; i < numframes_; i++)
+	  rows_[i] *= sa_.dims[0];
+
+	return propagateFramesVarSize(&times_[0], 0 /*weight to disappear*/, values_, &rows_[0], numframes_);
+      }
+
+      return propagateFramesTimeTagged(&times_[0], 0 /*weight to disappear*/, values_, rows_[0] * sa_.dims[0], numframes_);
+    }
+
+    void cancelBlock ()
+    {
+      block_ = false;
+      count_ = numpar_;
+    }
+
   public:
+    /** accept strided or sparse float frames, so that views are not packed and sparse frames not densified before being merged */
+    void negotiateInputFormat (PiPoStreamFormat &format)
+    {
+      if (format.valueType != PiPoStreamFormat::Float32  ||  format.layout != PiPoStreamFormat::Interleaved)
+        format = PiPoStreamFormat();
+      else
+        format.alignment = 0;
+    }
+
     int streamAttributes (bool hasTimeTags, double rate, double offset, unsigned int width, unsigned int height, const char **labels, bool hasVarSize, double domain, unsigned int maxFrames)
     { // collect stream attributes declarations from parallel pipos
 #if PIPO_DEBUG >= 1
@@ -135,38 +217,37 @@ private:
 	     hasTimeTags, rate, offset, width, height, labels ? labels[0] : "n/a", hasVarSize, domain, maxFrames);
 #endif
 
-      if (count_ == 0)
-      {	// first parallel pipo defines most stream attributes, we store then here
-	sa_.hasTimeTags = hasTimeTags;
-    	sa_.rate = rate;
-    	sa_.offset = offset;
-    	sa_.dims[0] = width;
-    	sa_.dims[1] = height;
-    	sa_.numLabels = 0;
-    	sa_.hasVarSize = hasVarSize;
-    	sa_.domain = domain;
-    	sa_.maxFrames = maxFrames;
-	sa_.concat_labels(labels, width);
-	
-	paroffset_[0] = 0;
-	parwidth_[0] = width;
-      }
-      else
-      { // apply merge rules with following pipos
-	// columns are concatenated
-	sa_.concat_labels(labels, width);
-      	sa_.dims[0] += width;
-	paroffset_[count_] = paroffset_[count_ - 1] + parwidth_[count_ - 1];
-	parwidth_[count_] = width;
-
-	//TODO: check maxframes, height, should not differ
-	//TODO: option to transpose column vectors
-      }
+      // keep this branch's stream attributes and strides as negotiated
+      parsa_[count_].assign(hasTimeTags, rate, offset, width, height, labels, hasVarSize, domain, maxFrames);
+      parrowstride_[count_]   = getInputFormat().rowStride;
+      parframestride_[count_] = getInputFormat().frameStride;
+      parsparse_[count_]      = getInputFormat().encoding == PiPoStreamFormat::Sparse;
       
-      if (++count_ == numpar_)
-      { // last parallel pipo, now reserve memory and pass merged stream attributes onwards
+      if (restart_  ||  ++count_ == numpar_)
+      { // last parallel pipo (or restarted branch), now combine, reserve memory and pass merged stream attributes onwards
+	restart_ = false;
+	count_   = numpar_;
+	combine();
         framesize_ = sa_.dims[0] * sa_.dims[1];
-	values_ = (PiPoValue *) realloc(values_, sa_.maxFrames * framesize_ * sizeof(PiPoValue)); // alloc space for maxmal block size
+
+	// merge directly into the padding and alignment the receiver asks for (our buffer starts at 64 bytes)
+	setOutputFormat(PiPoStreamFormat());
+	sa_.format = getPreferredOutputFormat(sa_.dims[0], sa_.dims[1]);
+
+	if (sa_.format.valueType != PiPoStreamFormat::Float32  ||  sa_.format.layout != PiPoStreamFormat::Interleaved
+	    ||  sa_.format.encoding != PiPoStreamFormat::Dense  ||  sa_.format.alignment > PiPoAlignedBuffer::defaultAlignment)
+	{ // anything else is converted on the edge
+	  sa_.format = PiPoStreamFormat();
+	  sa_.format.resolve(sa_.dims[0], sa_.dims[1]);
+	}
+
+	rowstride_   = sa_.format.rowStride;
+	framestride_ = sa_.format.frameStride;
+	setOutputFormat(sa_.format);
+	declareBuffer(values_, sa_.maxFrames * framestride_); // space for maximal block size
+	times_.resize(sa_.maxFrames);
+	rows_.resize(sa_.maxFrames);
+	setOutputWritable(true); // values_ is rewritten for every block
 	
 	return propagateStreamAttributes(sa_.hasTimeTags, sa_.rate, sa_.offset, sa_.dims[0], sa_.dims[1], sa_.labels, sa_.hasVarSize, sa_.domain, sa_.maxFrames);
       }
@@ -175,6 +256,46 @@ private:
     }
 
     
+  private:
+    void combine ()
+    { // first parallel pipo defines most stream attributes, columns are concatenated
+      const PiPoStreamAttributes &first = parsa_[0];
+
+      sa_.hasTimeTags = first.hasTimeTags;
+      sa_.rate = first.rate;
+      sa_.offset = first.offset;
+      sa_.dims[0] = 0;
+      sa_.dims[1] = first.dims[1];
+      sa_.numLabels = 0;
+      sa_.hasVarSize = first.hasVarSize;
+      sa_.domain = first.domain;
+      sa_.maxFrames = first.maxFrames;
+
+      for (int i = 0; i < numpar_; i++)
+      {
+	unsigned int width = parsa_[i].dims[0];
+
+	sa_.concat_labels(parsa_[i].numLabels > 0  ?  parsa_[i].labels  :  NULL, width);
+	paroffset_[i] = sa_.dims[0];
+	parwidth_[i]  = width;
+	sa_.dims[0]  += width;
+
+	//TODO: check maxframes, height, should not differ
+	//TODO: option to transpose column vectors
+      }
+    }
+
+    void copyBranchAttributes (const PiPoMerge &other)
+    {
+      for (int i = 0; i < numpar_; i++)
+      {
+	const PiPoStreamAttributes &sa = other.parsa_[i];
+
+	parsa_[i].assign(sa.hasTimeTags != 0, sa.rate, sa.offset, sa.dims[0], sa.dims[1], sa.numLabels > 0  ?  sa.labels  :  NULL, sa.hasVarSize, sa.domain, sa.maxFrames);
+      }
+    }
+
+  public:
     int reset ()
     {
       if (++count_ == numpar_)
@@ -186,28 +307,28 @@ private:
     
     int frames (double time, double weight, PiPoValue *values, unsigned int size, unsigned int num)
     { // collect data from parallel pipos
+      if (block_)
+	return collect(time, NULL, values, size, NULL, num);
+
       if (count_ >= numpar_) // bug is still there
       {
-#ifdef WIN32
-        printf("%s: ARGH! count_ %d >= numpar_ %d\n", __FUNCSIG__, count_, numpar_);
-#else
-        printf("%s: ARGH! count_ %d >= numpar_ %d\n", __PRETTY_FUNCTION__, count_, numpar_);
-#endif
+        postDiagnostic(PiPoDiagnostic::Overflow, PiPoDiagnostic::Error, "PiPoMerge: received block %g of %g parallel branches", count_ + 1, numpar_);
         count_ = numpar_ - 1;
       }
       //assert(size / parwidth_[count_] == 1);
 
       int width = parwidth_[count_];
-      unsigned int height = size / width;	// number of input rows
+      unsigned int height = parsparse_[count_]  ?  sa_.dims[1]  :  size / width;	// number of input rows
       
       if (count_ == 0)
       { // first parallel pipo determines time tag, num. rows and frames
 	time_      = time;
 	numrows_   = height;
 	numframes_ = num;
+	activity_  = getInputActivity();
 
 	// clear memory just in case one pipo doesn't output data (FIXME: handle this correctly)
-	memset(values_, 0, num * framesize_ * sizeof(PiPoValue));
+	memset(values_, 0, num * framestride_ * sizeof(PiPoValue));
       }
 
       // copy input data to be kept from parallel pipo to merged values_
@@ -215,22 +336,115 @@ private:
       if (height > numrows_)	height = numrows_;
       
       for (unsigned int i = 0; i < num; i++)   // for all frames present
-	for (unsigned int k = 0; k < height; k++)   // for all rows to be kept
-        {
-          //printf("merge::frames %p\n  values_ %p + %d + %d + %d,\n  values %p + %d,\n  size %d\n",
-          //       this, values_, i * framesize_, k * sa_.dims[0], paroffset_[count_], values, i * size, parwidth_[count_] * sizeof(PiPoValue));
-	  //TODO: zero pad if num rows here: size / parwidth_[count_] < numrows_
-	  memcpy(values_ + i * framesize_ + k * sa_.dims[0] + paroffset_[count_],
-		 values  + i * size + k * width,  width * sizeof(PiPoValue));
-        }
+	copyFrame(count_, values_ + i * framestride_, values + i * parframestride_[count_], height);
       
+      if (count_ > 0)
+	activity_ &= getInputActivity();
+
       if (++count_ == numpar_) // last parallel pipo: pass on to receiver(s)
+      {
+	setOutputActivity(activity_);
 	return propagateFrames(time_, 0 /*weight to disappear*/, values_, numrows_ * sa_.dims[0], numframes_);
+      }
       else
 	return 0; // continue receiving frames
     }
 
+    int framesTimeTagged (const double *times, double weight, PiPoValue *values, unsigned int size, unsigned int num)
+    {
+      if (block_)
+	return collect(0, times, values, size, NULL, num);
+
+      return PiPo::framesTimeTagged(times, weight, values, size, num);
+    }
 
+    int framesVarSize (const double *times, double weight, PiPoValue *values, const unsigned int *sizes, unsigned int num)
+    {
+      if (block_)
+	return collect(0, times, values, 0, sizes, num);
+
+      return PiPo::framesVarSize(times, weight, values, sizes, num);
+    }
+
+  private:
+    // copy the rows to be kept of a frame of a parallel pipo into a merged frame
+    void copyFrame (int branch, PiPoValue *dst, const PiPoValue *src, unsigned int height)
+    {
+      int width = parwidth_[branch];
+
+      if (parsparse_[branch])
+      { // scatter non-zero values of sparse frames into the cleared merged frames
+	unsigned int count = (unsigned int) src[0];
+
+	for (unsigned int j = 0; j < count; j++)
+	{
+	  unsigned int index = (unsigned int) src[1 + 2 * j];
+	  unsigned int row = index / width;
+
+	  if (row < height)
+	    dst[row * rowstride_ + paroffset_[branch] + index % width] = src[2 + 2 * j];
+	}
+      }
+      else
+      {
+	for (unsigned int k = 0; k < height; k++)   // for all rows to be kept
+	  //TODO: zero pad if num rows here: size / parwidth_[count_] < numrows_
+	  memcpy(dst + k * rowstride_ + paroffset_[branch], src + k * parrowstride_[branch], width * sizeof(PiPoValue));
+      }
+    }
+
+    // collect frames of branch_ for a block, with a time-tag (times or from time and rate) and a size (sizes or size) per frame
+    int collect (double time, const double *times, PiPoValue *values, unsigned int size, const unsigned int *sizes, unsigned int num)
+    {
+      unsigned int first = branchframes_;
+      unsigned int width = parwidth_[branch_] > 0  ?  parwidth_[branch_]  :  1;
+
+      branchframes_ += num;
+
+      if (branch_ == 0)
+      { // first parallel pipo determines time tags, rows and number of frames
+	const PiPoStreamAttributes &sa = parsa_[0];
+	double period = (!sa.hasTimeTags  &&  sa.rate > 0)  ?  1000.0 / sa.rate  :  0;
+
+	if (first >= sa_.maxFrames)
+	  num = 0;
+	else if (first + num > sa_.maxFrames)
+	  num = sa_.maxFrames - first;
+
+	for (unsigned int i = 0; i < num; i++)
+	{
+	  times_[first + i] = times != NULL  ?  times[i]  :  time + i * period;
+	  rows_[first + i]  = parsparse_[0]  ?  sa_.dims[1]  :  (sizes != NULL  ?  sizes[i]  :  size) / width;
+	}
+
+	memset(values_ + first * framestride_, 0, num * framestride_ * sizeof(PiPoValue));
+	numframes_ = first + num;
+	activity_  = (first == 0)  ?  getInputActivity()  :  activity_ & getInputActivity();
+      }
+      else
+      { // keep the frames the first branch passed
+	if (first >= numframes_)
+	  num = 0;
+	else if (first + num > numframes_)
+	  num = numframes_ - first;
+
+	activity_ &= getInputActivity();
+      }
+
+      for (unsigned int i = 0; i < num; i++)
+      {
+	unsigned int height = parsparse_[branch_]  ?  sa_.dims[1]  :  (sizes != NULL  ?  sizes[i]  :  size) / width;
+
+	if (height > rows_[first + i])
+	  height = rows_[first + i];
+
+	copyFrame(branch_, values_ + (first + i) * framestride_, values + i * parframestride_[branch_], height);
+      }
+
+      return 0; // the merged block is passed on by endBlock()
+    }
+
+  public:
     int finalize (double inputEnd)
     {
       if (count_ == 0)
@@ -290,6 +504,14 @@ public:
     add(&pipo);
   }
 
+  /** let the merge expect the stream attributes of branch @p{index} only, to be called before
+      restarting the propagation of stream attributes at a module within the branch (see PiPo::restartStreamAttributes())
+   */
+  void restartBranch (unsigned int index)
+  {
+    merge.restart(index);
+  }
+
   /** @} PiPoParallel setup methods */
 
   /** @name overloaded PiPo methods */
@@ -298,7 +520,8 @@ public:
   void setParent (PiPo::Parent *parent)
   {
     this->parent = parent;
-    
+    merge.setParent(parent);
+
     for (unsigned int i = 0; i < receivers.size(); i++)
       receivers[i]->setParent(parent);
   }
@@ -307,6 +530,24 @@ public:
   {
     merge.setReceiver(receiver, add);
   }
+
+  void visitBuffers (PiPo::BufferVisitor &visitor)
+  {
+    PiPo::visitBuffers(visitor);
+    visitor.module(&merge); // merge buffer is filled by all branches
+
+    for (unsigned int i = 0; i < receivers.size(); i++)
+    { // the buffers of a branch are free once it has passed its frames to merge,
+      // but merge passes them on from within the last branch's frames()
+      visitor.beginBranch();
+      receivers[i]->visitBuffers(visitor);
+      visitor.endBranch(i + 1 == receivers.size());
+    }
+  }
+
+  /** accept any format, the branches negotiate their own (converted on each branch's edge) */
+  void negotiateInputFormat (PiPoStreamFormat &format)
+  { }
     
   /** @name preparation and processing methods: just notify merge, and let propagate* do the branching */
   /** @{ */
@@ -315,6 +556,8 @@ public:
   int streamAttributes (bool hasTimeTags, double rate, double offset, unsigned int width, unsigned int height, const char **labels, bool hasVarSize, double domain, unsigned int maxFrames)
   {
     merge.start(receivers.size());
+    setOutputWritable(isInputWritable()); // only passed on when there is a single branch
+    setOutputFormat(getInputFormat());
     return PiPo::propagateStreamAttributes(hasTimeTags, rate, offset, width, height, labels, hasVarSize, domain, maxFrames);
   }
   
@@ -332,8 +575,55 @@ public:
   int frames (double time, double weight, PiPoValue *values, unsigned int size, unsigned int num)
   {
     merge.start(receivers.size());
+    setOutputActivity(getInputActivity());
     return PiPo::propagateFrames(time, weight, values, size, num);
   }
+
+  int framesTimeTagged (const double *times, double weight, PiPoValue *values, unsigned int size, unsigned int num)
+  { // a branch might split the block by time-tags: the merge collects each branch's frames and passes on one block
+    int ret = 0;
+
+    merge.beginBlock(receivers.size());
+    setOutputActivity(getInputActivity());
+    passActivity();
+
+    for (unsigned int i = 0; i < receivers.size()  &&  ret >= 0; i++)
+    {
+      merge.beginBranch(i);
+      ret = propagateFramesTimeTaggedTo(i, times, weight, values, size, num);
+    }
+
+    if (ret < 0)
+    {
+      merge.cancelBlock();
+      return ret;
+    }
+
+    return merge.endBlock(false);
+  }
+
+  int framesVarSize (const double *times, double weight, PiPoValue *values, const unsigned int *sizes, unsigned int num)
+  { // as above, the merge takes the rows of each frame from the first branch
+    int ret = 0;
+
+    merge.beginBlock(receivers.size());
+    setOutputActivity(getInputActivity());
+    passActivity();
+
+    for (unsigned int i = 0; i < receivers.size()  &&  ret >= 0; i++)
+    {
+      merge.beginBranch(i);
+      ret = propagateFramesVarSizeTo(i, times, weight, values, sizes, num);
+    }
+
+    if (ret < 0)
+    {
+      merge.cancelBlock();
+      return ret;
+    }
+
+    return merge.endBlock(true);
+  }
   
   int finalize (double inputEnd)
   {
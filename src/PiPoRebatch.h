@@ -0,0 +1,246 @@
+/**
+
+@file PiPoRebatch.h
+
+@brief PiPo module gathering frames into blocks of a fixed size.
+
+@copyright
+
+Copyright (c) 2012–2016 by IRCAM – Centre Pompidou, Paris, France.
+All rights reserved.
+
+@par License (BSD 3-clause)
+
+Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+
+- Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+
+- Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+- Neither the name of the copyright holder nor the names of its contributors may be used to endorse or promote products derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+#ifndef _PIPO_REBATCH_
+#define _PIPO_REBATCH_
+
+#include "PiPo.h"
+
+/** gather frames received one by one or in blocks of any size into blocks of a fixed size
+
+    Put in front of a chain fed with single frames or irregular host blocks,
+    so that the following modules process blocks of the given size:
+
+      PiPoRebatch rebatch(parent);
+      PiPoSequence seq(parent, rebatch, mfcc, stats);
+      rebatch.size_attr_.set(256);
+
+    Larger input blocks are cut into blocks of the given size, which is also
+    the maxFrames passed on.  With a latency bound (in ms), sampled streams
+    are passed on in blocks not longer than the bound, and time-tagged streams
+    as soon as a frame arrives that long after the first frame held.
+    finalize() passes on the frames still held.  The time-tags of the frames
+    are kept, time-tagged frames are passed on with framesTimeTagged(), and
+    variable size frames with framesVarSize().  The stream offset is increased by the maximal
+    delay of the output, (size - 1) frame periods or the latency bound.
+
+    To be created by name, register it with the collection of the host:
+
+      PiPoCollection::addToCollection("rebatch", new PiPoCreator<PiPoRebatch>);
+ */
+class PiPoRebatch : public PiPo
+{
+private:
+  PiPoValue *values_;           // gathered frames
+  std::vector<double> times_;   // time-tag of each gathered frame
+  std::vector<unsigned int> sizes_; // size of each gathered frame
+  unsigned int framesize_;      // values per frame
+  unsigned int blocksize_;      // frames per output block
+  unsigned int count_;          // frames gathered so far
+  double period_;               // frame period in ms of sampled streams (0 if time-tagged)
+  double latency_;              // latency bound in ms (0 for none)
+  bool timetags_;               // input has time-tags
+  bool varsize_;                // input has variable frame size
+  double weight_;               // weight of the last gathered frame
+
+public:
+  PiPoScalarAttr<int> size_attr_;
+  PiPoScalarAttr<double> latency_attr_;
+
+  PiPoRebatch (PiPo::Parent *parent, PiPo *receiver = NULL)
+  : PiPo(parent, receiver), values_(NULL), times_(), sizes_(), framesize_(0), blocksize_(1), count_(0),
+    period_(0), latency_(0), timetags_(false), varsize_(false), weight_(1),
+    size_attr_(this, "size", "Number of Frames per Output Block", true, 64),
+    latency_attr_(this, "latency", "Maximum Time a Frame is Held [ms] (0 for none)", true, 0)
+  { }
+
+  // the gathering buffer is declared again in streamAttributes
+  PiPoRebatch (const PiPoRebatch &other)
+  : PiPo(other.parent), values_(NULL), times_(other.times_), sizes_(other.sizes_), framesize_(other.framesize_), blocksize_(other.blocksize_), count_(0),
+    period_(other.period_), latency_(other.latency_), timetags_(other.timetags_), varsize_(other.varsize_), weight_(1),
+    size_attr_(this, "size", "Number of Frames per Output Block", true, const_cast<PiPoRebatch &>(other).size_attr_.get()),
+    latency_attr_(this, "latency", "Maximum Time a Frame is Held [ms] (0 for none)", true, const_cast<PiPoRebatch &>(other).latency_attr_.get())
+  { }
+
+  ~PiPoRebatch (void)
+  { }
+
+  int streamAttributes (bool hasTimeTags, double rate, double offset, unsigned int width, unsigned int height, const char **labels, bool hasVarSize, double domain, unsigned int maxFrames)
+  {
+    int size = size_attr_.get();
+    double delay;
+
+    framesize_ = width * height;
+    blocksize_ = size > 1  ?  (unsigned int) size  :  1;
+    latency_   = latency_attr_.get() > 0  ?  latency_attr_.get()  :  0;
+    period_    = (!hasTimeTags  &&  rate > 0)  ?  1000.0 / rate  :  0;
+    timetags_  = hasTimeTags;
+    varsize_   = hasVarSize;
+    count_     = 0;
+
+    // for sampled streams, the latency bound limits the block size
+    if (latency_ > 0  &&  period_ > 0  &&  latency_ < (blocksize_ - 1) * period_)
+      blocksize_ = (unsigned int) (latency_ / period_) + 1;
+
+    delay = (latency_ > 0  &&  (period_ == 0  ||  latency_ < (blocksize_ - 1) * period_))  ?  latency_
+          : (rate > 0  ?  (blocksize_ - 1) * 1000.0 / rate  :  0);
+
+    declareBuffer(values_, (size_t) blocksize_ * framesize_, BufferPersistent);
+    times_.resize(blocksize_);
+    sizes_.resize(blocksize_);
+
+    // blocks cut from the input are passed on as they are
+    setOutputWritable(isInputWritable());
+
+    return propagateStreamAttributes(hasTimeTags, rate, offset + delay, width, height, labels, hasVarSize, domain, blocksize_);
+  }
+
+  int reset ()
+  {
+    count_ = 0;
+
+    return propagateReset();
+  }
+
+  int frames (double time, double weight, PiPoValue *values, unsigned int size, unsigned int num)
+  {
+    unsigned int stride = getInputFormat().frameStride > 0  ?  getInputFormat().frameStride  :  size;
+    unsigned int i = 0;
+
+    // pass on full blocks of the input without copying
+    if (count_ == 0  &&  !timetags_  &&  num >= blocksize_)
+    {
+      unsigned int activity = getInputActivity();
+
+      for (; i + blocksize_ <= num; i += blocksize_)
+      {
+        int ret;
+
+        setOutputActivity(activity);
+        ret = propagateFrames(time + i * period_, weight, values + i * stride, size, blocksize_);
+
+        if (ret < 0)
+          return ret;
+      }
+    }
+
+    for (; i < num; i++)
+    {
+      int ret = gather(timetags_  ?  time  :  time + i * period_, weight, values + i * stride, size);
+
+      if (ret < 0)
+        return ret;
+    }
+
+    return 0;
+  }
+
+  int framesTimeTagged (const double *times, double weight, PiPoValue *values, unsigned int size, unsigned int num)
+  {
+    unsigned int stride = getInputFormat().frameStride > 0  ?  getInputFormat().frameStride  :  size;
+
+    for (unsigned int i = 0; i < num; i++)
+    {
+      int ret = gather(times[i], weight, values + i * stride, size);
+
+      if (ret < 0)
+        return ret;
+    }
+
+    return 0;
+  }
+
+  int framesVarSize (const double *times, double weight, PiPoValue *values, const unsigned int *sizes, unsigned int num)
+  {
+    unsigned int stride = getInputFormat().frameStride > 0  ?  getInputFormat().frameStride  :  framesize_;
+
+    for (unsigned int i = 0; i < num; i++)
+    {
+      int ret = gather(times[i], weight, values + i * stride, sizes[i]);
+
+      if (ret < 0)
+        return ret;
+    }
+
+    return 0;
+  }
+
+  int finalize (double inputEnd)
+  {
+    int ret = flush();
+
+    if (ret < 0)
+      return ret;
+
+    return propagateFinalize(inputEnd);
+  }
+
+private:
+  /** add one frame, pass on the block when it is full or its first frame has been held long enough */
+  int gather (double time, double weight, const PiPoValue *frame, unsigned int size)
+  {
+    if (size > framesize_)
+      size = framesize_;
+
+    memcpy(values_ + (size_t) count_ * framesize_, frame, size * sizeof(PiPoValue));
+    times_[count_] = time;
+    sizes_[count_] = size;
+    weight_ = weight;
+    count_++;
+
+    if (count_ == blocksize_  ||  (latency_ > 0  &&  time - times_[0] >= latency_))
+      return flush();
+
+    return 0;
+  }
+
+  /** pass on the gathered frames */
+  int flush ()
+  {
+    unsigned int num = count_;
+
+    if (num == 0)
+      return 0;
+
+    count_ = 0;
+
+    if (varsize_)
+      return propagateFramesVarSize(&times_[0], weight_, values_, &sizes_[0], num);
+
+    if (timetags_)
+      return propagateFramesTimeTagged(&times_[0], weight_, values_, sizes_[0], num);
+
+    return propagateFrames(times_[0], weight_, values_, sizes_[0], num);
+  }
+};
+
+/** EMACS **
+ * Local variables:
+ * mode: c++
+ * c-basic-offset:2
+ * End:
+ */
+
+#endif /* _PIPO_REBATCH_ */
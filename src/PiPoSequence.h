@@ -33,11 +33,15 @@ class PiPoSequence : public PiPo
 {
 private:    
   std::vector<PiPo *> seq_;
+  unsigned int tilesize_;  // frames per tile of large input blocks (0 for no tiling)
+  bool tiling_;            // input blocks are cut into tiles (interleaved input)
+  double period_;          // frame period in ms of sampled streams (0 if time-tagged)
+  size_t framebytes_;      // bytes between input frames
 
 public:
   // constructor
   PiPoSequence (PiPo::Parent *parent)
-  : PiPo(parent), seq_()
+  : PiPo(parent), seq_(), tilesize_(0), tiling_(false), period_(0), framebytes_(0)
   { }
 
 #if __cplusplus > 199711L // check for C++11
@@ -50,7 +54,7 @@ public:
    */
   template<typename ...Args>
   PiPoSequence (PiPo::Parent *parent, Args&... pipos)
-    : PiPo(parent), seq_{&pipos ...} // use C++11 initilizer_list syntax and variadic templates
+    : PiPo(parent), seq_{&pipos ...}, tilesize_(0), tiling_(false), period_(0), framebytes_(0) // use C++11 initilizer_list syntax and variadic templates
   {
     // set parents of all pipos?
     connect(NULL);
@@ -59,7 +63,7 @@ public:
   
   // copy constructor
   PiPoSequence (const PiPoSequence &other)
-  : PiPo(other), seq_(other.seq_)
+  : PiPo(other), seq_(other.seq_), tilesize_(other.tilesize_), tiling_(other.tiling_), period_(other.period_), framebytes_(other.framebytes_)
   { 
     connect(NULL);
   }  
@@ -69,6 +73,10 @@ public:
   {
     parent = other.parent;
     seq_   = other.seq_;
+    tilesize_ = other.tilesize_;
+    tiling_   = other.tiling_;
+    period_   = other.period_;
+    framebytes_ = other.framebytes_;
     connect(NULL);
 
     return *this;
@@ -130,6 +138,34 @@ public:
     return false;
   }
 
+  /** run input blocks larger than \p numFrames frames through the whole sequence in tiles of numFrames frames (0 for no tiling)
+
+      Each tile passes through all modules before the next one, so that the
+      data stays in cache between modules, instead of each module sweeping the
+      whole block.  The modules receive the tiles as consecutive blocks of at
+      most numFrames frames, which is also the maxFrames passed to them, so
+      that their buffers shrink to the tile size.  To be called before
+      streamAttributes().  Planar input blocks are not cut.
+   */
+  void setTileSize (unsigned int numFrames)
+  {
+    tilesize_ = numFrames;
+  }
+
+  unsigned int getTileSize () const
+  {
+    return tilesize_;
+  }
+
+  /** number of frames of width x height floats filling \p cacheBytes (by default half of a typical L2 cache) */
+  static unsigned int getCacheTileSize (unsigned int width, unsigned int height, size_t cacheBytes = 128 * 1024)
+  {
+    size_t frameBytes = (size_t) width * height * sizeof(PiPoValue);
+    size_t numFrames = frameBytes > 0  ?  cacheBytes / frameBytes  :  0;
+
+    return numFrames > 0  ?  (unsigned int) numFrames  :  1;
+  }
+
   /** @} PiPoSequence setup methods */
 
   /** @name PiPoChain query methods */
@@ -186,6 +222,23 @@ public:
     if (tail != NULL)
       tail->setReceiver(receiver, add);
   }
+
+  void visitBuffers (PiPo::BufferVisitor &visitor)
+  {
+    PiPo::visitBuffers(visitor);
+
+    for (unsigned int i = 0; i < seq_.size(); i++)
+      seq_[i]->visitBuffers(visitor);
+  }
+
+  /** the head receives our input */
+  void negotiateInputFormat (PiPoStreamFormat &format)
+  {
+    PiPo *head = getHead();
+
+    if (head != NULL)
+      head->negotiateInputFormat(format);
+  }
     
   /** @name preparation of processing */
   /** @{ */
@@ -196,7 +249,24 @@ public:
     PiPo *head = getHead();
     
     if (head != NULL)
-      return head->streamAttributes(hasTimeTags, rate, offset, width, height, labels, hasVarSize, domain, maxFrames);
+    { // the head receives our input directly, so it may overwrite it under the same condition as we may
+      head->setInputWritable(isInputWritable());
+      head->setInputFormat(getInputFormat());
+
+      // the modules receive tiles of at most tilesize_ frames
+      tiling_ = tilesize_ > 0  &&  tilesize_ < maxFrames  &&  getInputFormat().layout == PiPoStreamFormat::Interleaved;
+      period_ = (!hasTimeTags  &&  rate > 0)  ?  1000.0 / rate  :  0;
+
+      PiPoStreamFormat format = getInputFormat();
+
+      format.resolve(width, height);
+      framebytes_ = format.frameStride * format.getValueSize();
+
+      if (tiling_)
+        maxFrames = tilesize_;
+
+      return head->receiveStreamAttributes(hasTimeTags, rate, offset, width, height, labels, hasVarSize, domain, maxFrames);
+    }
     
     return -1;
   }
@@ -221,10 +291,78 @@ public:
     PiPo *head = getHead();
     
     if (head != NULL)
+    {
+      if (tiling_  &&  num > tilesize_)
+      { // each tile through the whole sequence
+        int ret = 0;
+
+        for (unsigned int i = 0; i < num  &&  ret >= 0; i += tilesize_)
+        {
+          head->setInputActivity(getInputActivity());
+          ret = head->frames(time + i * period_, weight, (PiPoValue *) ((char *) values + i * framebytes_), size, std::min(tilesize_, num - i));
+        }
+
+        return ret;
+      }
+
+      head->setInputActivity(getInputActivity());
       return head->frames(time, weight, values, size, num);
+    }
     
     return -1;
   }
+
+  int framesTimeTagged (const double *times, double weight, PiPoValue *values, unsigned int size, unsigned int num)
+  {
+    PiPo *head = getHead();
+
+    if (head != NULL)
+    {
+      if (tiling_  &&  num > tilesize_)
+      {
+        int ret = 0;
+
+        for (unsigned int i = 0; i < num  &&  ret >= 0; i += tilesize_)
+        {
+          head->setInputActivity(getInputActivity());
+          ret = head->framesTimeTagged(times + i, weight, (PiPoValue *) ((char *) values + i * framebytes_), size, std::min(tilesize_, num - i));
+        }
+
+        return ret;
+      }
+
+      head->setInputActivity(getInputActivity());
+      return head->framesTimeTagged(times, weight, values, size, num);
+    }
+
+    return -1;
+  }
+
+  int framesVarSize (const double *times, double weight, PiPoValue *values, const unsigned int *sizes, unsigned int num)
+  {
+    PiPo *head = getHead();
+
+    if (head != NULL)
+    {
+      if (tiling_  &&  num > tilesize_)
+      {
+        int ret = 0;
+
+        for (unsigned int i = 0; i < num  &&  ret >= 0; i += tilesize_)
+        {
+          head->setInputActivity(getInputActivity());
+          ret = head->framesVarSize(times + i, weight, (PiPoValue *) ((char *) values + i * framebytes_), sizes + i, std::min(tilesize_, num - i));
+        }
+
+        return ret;
+      }
+
+      head->setInputActivity(getInputActivity());
+      return head->framesVarSize(times, weight, values, sizes, num);
+    }
+
+    return -1;
+  }
   
   int finalize (double inputEnd)
   {
@@ -0,0 +1,300 @@
+/**
+
+@file PiPoStaticSequence.h
+
+@brief PiPo dataflow graph class that encapsulates a sequence of pipo modules given by their types at compile time.
+
+@copyright
+
+Copyright (c) 2012–2016 by IRCAM – Centre Pompidou, Paris, France.
+All rights reserved.
+
+@par License (BSD 3-clause)
+
+Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+
+- Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+
+- Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+- Neither the name of the copyright holder nor the names of its contributors may be used to endorse or promote products derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+#ifndef _PIPO_STATIC_SEQUENCE_
+#define _PIPO_STATIC_SEQUENCE_
+
+#if __cplusplus > 199711L // needs C++11 variadic templates
+
+#include "PiPo.h"
+
+#include <tuple>
+#include <string>
+#include <vector>
+#include <type_traits>
+
+/** sequence of pipo modules given by their types, owned by value:
+
+      PiPoStaticSequence<PiPoGain, MyFilter, MyStats> seq(parent);
+
+    The modules are members of the sequence, so that the calls of the host
+    into the sequence reach its first module without virtual dispatch.
+    Each module passes its frames on to the next one with propagateFrames(),
+    as in any sequence, since modules know their receivers as PiPo only.
+
+    An optional chain description in the syntax of PiPoChain gives the
+    instance names under which the attributes of the modules are exposed as
+    attributes of the sequence (e.g. "gain.gain").  It can be checked at
+    compile time:
+
+      typedef PiPoStaticSequence<PiPoGain, MyFilter, MyStats> MySeq;
+      constexpr const char *desc = "gain:filter(lop):stats";
+      static_assert(MySeq::isDescription(desc), "wrong number of modules in description");
+      MySeq seq(parent, desc);
+ */
+template<typename ...Stages>
+class PiPoStaticSequence : public PiPo
+{
+public:
+  static constexpr unsigned int numStages = sizeof...(Stages);
+  static_assert(numStages > 0, "PiPoStaticSequence needs at least one module");
+
+  typedef std::tuple<Stages...> StageTuple;
+  typedef typename std::tuple_element<0, StageTuple>::type Head;
+  typedef typename std::tuple_element<numStages - 1, StageTuple>::type Tail;
+
+  /** number of modules in chain description \p desc (modules are separated by ':') */
+  static constexpr unsigned int countStages(const char *desc, unsigned int count = 1)
+  {
+    return *desc == '\0'  ?  count  :  countStages(desc + 1, count + (*desc == ':'));
+  }
+
+  /** true if chain description \p desc names as many modules as the sequence has */
+  static constexpr bool isDescription(const char *desc)
+  {
+    return countStages(desc) == numStages;
+  }
+
+private:
+  StageTuple stages_;
+  PiPo *pipos_[numStages];
+  std::vector<std::string> instanceNames_;
+  std::vector<std::string> attrNames_;
+  std::vector<std::string> attrDescrs_;
+
+public:
+  /** create modules with \p parent, and expose their attributes under the instance names given by \p desc (if not NULL) */
+  PiPoStaticSequence (PiPo::Parent *parent, const char *desc = NULL)
+  : PiPo(parent), stages_(parentOf<Stages>(parent)...), instanceNames_(), attrNames_(), attrDescrs_()
+  {
+    link(std::integral_constant<unsigned int, 0>());
+
+    if (desc != NULL  &&  countStages(desc) == numStages)
+      exposeAttributes(desc);
+  }
+
+  // modules and their attributes are not copyable in general
+  PiPoStaticSequence (const PiPoStaticSequence &other) = delete;
+  PiPoStaticSequence &operator= (const PiPoStaticSequence &other) = delete;
+
+  ~PiPoStaticSequence (void) { }
+
+  /** @name PiPoStaticSequence query methods */
+  /** @{ */
+
+  /** typed access to module \p I */
+  template<unsigned int I>
+  typename std::tuple_element<I, StageTuple>::type &getStage ()
+  {
+    return std::get<I>(stages_);
+  }
+
+  size_t getSize () const
+  {
+    return numStages;
+  }
+
+  PiPo *getHead () const
+  {
+    return pipos_[0];
+  }
+
+  PiPo *getTail () const
+  {
+    return pipos_[numStages - 1];
+  }
+
+  PiPo *getPiPo (unsigned int index) const
+  {
+    if (index < numStages)
+      return pipos_[index];
+
+    return NULL;
+  }
+
+  /** instance name of module \p index as given by the chain description, NULL without description */
+  const char *getInstanceName (unsigned int index) const
+  {
+    if (index < instanceNames_.size())
+      return instanceNames_[index].c_str();
+
+    return NULL;
+  }
+
+  /** @} PiPoStaticSequence query methods */
+
+  /** @name overloaded PiPo methods */
+  /** @{ */
+
+  void setParent (PiPo::Parent *parent)
+  {
+    this->parent = parent;
+
+    for (unsigned int i = 0; i < numStages; i++)
+      pipos_[i]->setParent(parent);
+  }
+
+  void setReceiver (PiPo *receiver, bool add = false)
+  {
+    std::get<numStages - 1>(stages_).setReceiver(receiver, add);
+  }
+
+  void visitBuffers (PiPo::BufferVisitor &visitor)
+  {
+    PiPo::visitBuffers(visitor);
+
+    for (unsigned int i = 0; i < numStages; i++)
+      pipos_[i]->visitBuffers(visitor);
+  }
+
+  void negotiateInputFormat (PiPoStreamFormat &format)
+  {
+    std::get<0>(stages_).Head::negotiateInputFormat(format);
+  }
+
+  /** @name preparation of processing */
+  /** @{ */
+
+  int streamAttributes (bool hasTimeTags, double rate, double offset, unsigned int width, unsigned int height, const char **labels, bool hasVarSize, double domain, unsigned int maxFrames)
+  {
+    Head &head = std::get<0>(stages_);
+
+    head.setInputWritable(isInputWritable());
+    head.setInputFormat(getInputFormat());
+    return head.receiveStreamAttributes(hasTimeTags, rate, offset, width, height, labels, hasVarSize, domain, maxFrames);
+  }
+
+  int reset ()
+  {
+    return std::get<0>(stages_).Head::reset();
+  }
+
+  /** @} end of preparation of processing methods */
+
+  /** @name processing */
+  /** @{ */
+
+  int frames (double time, double weight, PiPoValue *values, unsigned int size, unsigned int num)
+  {
+    Head &head = std::get<0>(stages_);
+
+    head.setInputActivity(getInputActivity());
+    return head.Head::frames(time, weight, values, size, num);
+  }
+
+  int framesTimeTagged (const double *times, double weight, PiPoValue *values, unsigned int size, unsigned int num)
+  {
+    Head &head = std::get<0>(stages_);
+
+    head.setInputActivity(getInputActivity());
+    return head.Head::framesTimeTagged(times, weight, values, size, num);
+  }
+
+  int framesVarSize (const double *times, double weight, PiPoValue *values, const unsigned int *sizes, unsigned int num)
+  {
+    Head &head = std::get<0>(stages_);
+
+    head.setInputActivity(getInputActivity());
+    return head.Head::framesVarSize(times, weight, values, sizes, num);
+  }
+
+  int finalize (double inputEnd)
+  {
+    return std::get<0>(stages_).Head::finalize(inputEnd);
+  }
+
+  /** @} end of processing methods */
+  /** @} end of overloaded PiPo methods */
+
+private:
+  /** construct each module in place with the parent (modules registered their attributes with themselves and can't be moved) */
+  template<typename Stage>
+  static PiPo::Parent *parentOf (PiPo::Parent *parent) { return parent; }
+
+  /** connect module I - 1 to module I */
+  template<unsigned int I>
+  void link (std::integral_constant<unsigned int, I>)
+  {
+    pipos_[I] = &std::get<I>(stages_);
+
+    if (I > 0)
+      pipos_[I - 1]->setReceiver(pipos_[I]);
+
+    link(std::integral_constant<unsigned int, I + 1>());
+  }
+
+  void link (std::integral_constant<unsigned int, numStages>) { }
+
+  /** parse instance names (as PiPoOp::parse) and add modules' attributes as "instance.attr" */
+  void exposeAttributes (const char *desc)
+  {
+    std::string str(desc);
+    size_t pos = 0;
+
+    while (pos < std::string::npos)
+    {
+      size_t end = str.find_first_of(':', pos);
+      size_t open = str.find_first_of('(', pos);
+      size_t closed = str.find_first_of(')', pos);
+      size_t len = (end < std::string::npos  ?  end - pos  :  std::string::npos);
+
+      if (open < end  &&  closed < end)
+        instanceNames_.push_back(str.substr(open + 1, closed - open - 1));
+      else
+        instanceNames_.push_back(str.substr(pos, len));
+
+      pos = (end < std::string::npos  ?  end + 1  :  std::string::npos);
+    }
+
+    // build all names first, the attributes keep pointers to them
+    for (unsigned int i = 0; i < numStages; i++)
+    {
+      for (unsigned int j = 0; j < pipos_[i]->getNumAttrs(); j++)
+      {
+        PiPo::Attr *attr = pipos_[i]->getAttr(j);
+
+        attrNames_.push_back(instanceNames_[i] + "." + attr->getName());
+        attrDescrs_.push_back(std::string(attr->getDescr()) + " (" + instanceNames_[i] + ")");
+      }
+    }
+
+    unsigned int k = 0;
+
+    for (unsigned int i = 0; i < numStages; i++)
+      for (unsigned int j = 0; j < pipos_[i]->getNumAttrs(); j++, k++)
+        this->addAttr(this, attrNames_[k].c_str(), attrDescrs_[k].c_str(), pipos_[i]->getAttr(j));
+  }
+};
+
+#endif /* C++11 */
+
+/** EMACS **
+ * Local variables:
+ * mode: c++
+ * c-basic-offset:2
+ * End:
+ */
+
+#endif /* _PIPO_STATIC_SEQUENCE_ */
@@ -0,0 +1,877 @@
+/**
+ * @file PiPoStreamFormat.h
+ *
+ * @brief Memory format of the values of a PiPo stream and conversion between formats.
+ *
+ * A PiPo stream carries float values (PiPoValue) by default.  Modules and hosts can
+ * negotiate another value type for an edge during stream attributes propagation
+ * (see PiPo::negotiateInputFormat()).  Where two connected modules disagree, the
+ * sender converts its output with a PiPoFormatConverter before passing it on.
+ *
+ * The values passed to PiPo::frames() then point to data of the negotiated type,
+ * cast to PiPoValue *.  Int16 values represent fixed-point numbers in [-1, 1[
+ * (like PCM audio samples), Float16 values are IEEE 754 half precision numbers.
+ *
+ * The layout of a block of frames is either interleaved (frame by frame, the
+ * default) or planar (channel-major: for a block of num frames, value j of
+ * frame i is at index j * num + i, as per-channel kernels like filters prefer).
+ * The converter transposes the blocks between both layouts in cache-sized tiles.
+ *
+ * Interleaved frames can be padded: the rows of a frame (of width values) start
+ * every rowStride values, and the frames every frameStride values.  A format
+ * also states the alignment in bytes guaranteed for the start of the block and
+ * of every row, so that modules can use aligned SIMD loads and process the
+ * padding of the last vector of a row instead of a scalar tail.
+ *
+ * Strides also let a module pass on a view of its input without copying,
+ * e.g. a selection of columns or rows of matrix frames (see getView()).
+ * Receivers that accept strided frames leave the proposed strides in
+ * PiPo::negotiateInputFormat(), all others get packed frames through the edge
+ * converter.  A module can also pack a view itself when it needs contiguous
+ * frames only in some cases (see PiPoFormatConverter::setupPacking()).
+ *
+ * Frames that are mostly zeros (peak lists, onset matrices, activation maps)
+ * can be passed sparse: each frame starts with the number n of non-zero
+ * values, followed by n pairs of element index (row * width + column, in
+ * increasing order) and value, all as floats.  The size passed with a block
+ * of sparse frames is the largest 1 + 2 * n of the block, the frames start
+ * every frameStride values (by default room for all width * height values).
+ * Receivers that don't accept sparse frames get them densified by the edge
+ * converter, and dense frames are sparsified for receivers asking for them.
+ *
+ * @copyright
+ * Copyright (c) 2012–2016 by IRCAM – Centre Pompidou, Paris, France.
+ * All rights reserved.
+ *
+ * License (BSD 3-clause)
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef _PIPO_STREAM_FORMAT_
+#define _PIPO_STREAM_FORMAT_
+
+#include <vector>
+#include <cstring>
+#include <algorithm>
+
+#if defined(__F16C__)
+#include <immintrin.h>
+#endif
+
+/**
+ * Memory format of the values of a stream
+ */
+struct PiPoStreamFormat
+{
+  enum ValueType
+  {
+    Float32 = 0,  /**< float (PiPoValue), the default */
+    Int16,        /**< 16 bit fixed-point in [-1, 1[ */
+    Float16,      /**< 16 bit IEEE half float (storage only) */
+    Float64,      /**< double */
+    NumValueTypes
+  };
+
+  enum Layout
+  {
+    Interleaved = 0, /**< frame by frame, values of a frame are contiguous (the default) */
+    Planar,          /**< channel-major, compact: the values of one element of all frames of a block are contiguous */
+    NumLayouts
+  };
+
+  enum Encoding
+  {
+    Dense = 0,  /**< all values of the frames (the default) */
+    Sparse,     /**< float count and index/value pairs of the non-zero values of each frame, interleaved */
+    NumEncodings
+  };
+
+  enum ValueType valueType;
+  enum Layout layout;
+  enum Encoding encoding;
+  unsigned int alignment;   /**< alignment in bytes of the block and of each row (0 for none guaranteed) */
+  unsigned int rowStride;   /**< values between the starts of the rows of a frame (0: width, padded to alignment) */
+  unsigned int frameStride; /**< values between the starts of frames (0: rowStride * height) */
+
+  PiPoStreamFormat (enum ValueType valueType = Float32, enum Layout layout = Interleaved, unsigned int alignment = 0)
+  : valueType(valueType), layout(layout), encoding(Dense), alignment(alignment), rowStride(0), frameStride(0)
+  { }
+
+  /** format of sparse frames (float count and index/value pairs) */
+  static PiPoStreamFormat sparse (unsigned int alignment = 0)
+  {
+    PiPoStreamFormat format(Float32, Interleaved, alignment);
+
+    format.encoding = Sparse;
+
+    return format;
+  }
+
+  bool operator== (const PiPoStreamFormat &other) const
+  {
+    return this->valueType == other.valueType  &&  this->layout == other.layout  &&  this->encoding == other.encoding
+        &&  this->alignment == other.alignment  &&  this->rowStride == other.rowStride  &&  this->frameStride == other.frameStride;
+  }
+
+  bool operator!= (const PiPoStreamFormat &other) const
+  {
+    return !(*this == other);
+  }
+
+  /** size of one value in bytes */
+  static size_t getValueSize (enum ValueType type)
+  {
+    static const size_t sizes[NumValueTypes] = { sizeof(float), sizeof(short), sizeof(unsigned short), sizeof(double) };
+
+    return sizes[type];
+  }
+
+  size_t getValueSize () const
+  {
+    return getValueSize(this->valueType);
+  }
+
+  /** fill in the strides left to 0 for frames of width x height values (planar blocks are always compact) */
+  void resolve (unsigned int width, unsigned int height)
+  {
+    if (this->encoding == Sparse)
+    { // room for the count and a pair for every value
+      this->rowStride = 0;
+
+      if (this->frameStride == 0)
+        this->frameStride = 1 + 2 * width * height;
+
+      return;
+    }
+
+    if (this->layout == Planar)
+    {
+      this->rowStride = this->frameStride = 0;
+      return;
+    }
+
+    if (this->rowStride == 0)
+    {
+      size_t valueSize = getValueSize();
+      size_t align = this->alignment > valueSize  ?  this->alignment  :  valueSize;
+
+      this->rowStride = (unsigned int) (((width * valueSize + align - 1) / align * align) / valueSize);
+    }
+
+    if (this->frameStride == 0)
+      this->frameStride = this->rowStride * height;
+  }
+
+  /** true if values in this (resolved) format can be passed as is to a receiver asking for the (resolved) format \p required */
+  bool satisfies (const PiPoStreamFormat &required) const
+  {
+    return this->valueType == required.valueType  &&  this->layout == required.layout  &&  this->encoding == required.encoding
+        &&  this->rowStride == required.rowStride  &&  this->frameStride == required.frameStride
+        &&  this->alignment >= required.alignment;
+  }
+
+  /** true if the (resolved) format has no padding for frames of width x height values */
+  bool isPacked (unsigned int width, unsigned int height) const
+  {
+    if (this->encoding == Sparse)
+      return false;
+
+    return this->layout == Planar  ||  (this->rowStride == width  &&  this->frameStride == width * height);
+  }
+
+  /**
+   * Format of a view of the frames in this (resolved) format, starting at column \p colOffset and row \p rowOffset
+   *
+   * The view keeps the strides, so that any number of columns and rows up to the end of the frames can be passed on
+   * with the values pointer advanced by getViewOffset().  The alignment is kept only if the offset preserves it.
+   * Planar blocks can only be viewed by whole planes, i.e. columns of frames of one row.
+   * For example, a module passing on columns 10 to 19 of its input:
+   *
+   * \code
+   *  // in streamAttributes()
+   *  setOutputFormat(getInputFormat().getView(10, 0));
+   *  return propagateStreamAttributes(hasTimeTags, rate, offset, 10, height, labels + 10, hasVarSize, domain, maxFrames);
+   *
+   *  // in frames()
+   *  return propagateFrames(time, weight, values + getInputFormat().getViewOffset(10, 0, num), 10 * height, num);
+   * \endcode
+   */
+  PiPoStreamFormat getView (unsigned int colOffset, unsigned int rowOffset) const
+  {
+    PiPoStreamFormat view = *this;
+    size_t offset = (this->layout == Planar  ?  colOffset  :  rowOffset * this->rowStride + colOffset) * getValueSize();
+
+    if (this->alignment > 0  &&  (this->layout == Planar  ||  offset % this->alignment != 0))
+      view.alignment = 0; // planar offsets depend on the block size
+
+    return view;
+  }
+
+  /** offset in values of the start of the view at column \p colOffset and row \p rowOffset in a block of num frames */
+  size_t getViewOffset (unsigned int colOffset, unsigned int rowOffset, unsigned int num) const
+  {
+    if (this->layout == Planar)
+      return (size_t) colOffset * num;
+
+    return (size_t) rowOffset * this->rowStride + colOffset;
+  }
+
+  /**
+   * Ask for rows aligned to \p bytes, to be called in PiPo::negotiateInputFormat()
+   *
+   * Keeps the proposed strides if they preserve the alignment, otherwise asks for padded frames.
+   */
+  void requireAlignment (unsigned int bytes)
+  {
+    if (this->alignment < bytes  ||  (this->rowStride * getValueSize()) % bytes != 0  ||  (this->frameStride * getValueSize()) % bytes != 0)
+      this->rowStride = this->frameStride = 0;
+
+    this->alignment = bytes;
+  }
+
+  static const char *getValueTypeName (enum ValueType type)
+  {
+    static const char *names[NumValueTypes] = { "float32", "int16", "float16", "float64" };
+
+    return names[type];
+  }
+
+  static const char *getLayoutName (enum Layout layout)
+  {
+    static const char *names[NumLayouts] = { "interleaved", "planar" };
+
+    return names[layout];
+  }
+
+  static const char *getEncodingName (enum Encoding encoding)
+  {
+    static const char *names[NumEncodings] = { "dense", "sparse" };
+
+    return names[encoding];
+  }
+};
+
+
+/**
+ * Byte buffer with aligned start
+ */
+class PiPoAlignedBuffer
+{
+public:
+  /** default alignment, a cache line */
+  static const size_t defaultAlignment = 64;
+
+private:
+  std::vector<char> storage_;
+  char *data_;
+  size_t size_;
+
+public:
+  PiPoAlignedBuffer ()
+  : storage_(), data_(NULL), size_(0)
+  { }
+
+  /** the copy has the same contents at an aligned start */
+  PiPoAlignedBuffer (const PiPoAlignedBuffer &other)
+  : storage_(), data_(NULL), size_(0)
+  {
+    *this = other;
+  }
+
+  PiPoAlignedBuffer &operator= (const PiPoAlignedBuffer &other)
+  {
+    if (this != &other)
+    {
+      resize(other.size_);
+
+      if (other.size_ > 0)
+        memcpy(this->data_, other.data_, other.size_);
+    }
+
+    return *this;
+  }
+
+  /** reserve bytes at an address aligned to alignment (a power of 2), the contents are lost */
+  void resize (size_t bytes, size_t alignment = defaultAlignment)
+  {
+    if (bytes == 0)
+    {
+      std::vector<char>().swap(this->storage_);
+      this->data_ = NULL;
+    }
+    else
+    {
+      this->storage_.resize(bytes + alignment);
+      this->data_ = &this->storage_[0] + (alignment - ((size_t) &this->storage_[0]) % alignment) % alignment;
+    }
+
+    this->size_ = bytes;
+  }
+
+  void *data () { return this->data_; }
+  size_t size () const { return this->size_; }
+};
+
+
+/**
+ * Conversion of one value type to float and back, per value type
+ */
+template<int Type> struct PiPoValueCodec;
+
+template<> struct PiPoValueCodec<PiPoStreamFormat::Float32>
+{
+  typedef float type;
+  static float load (float v) { return v; }
+  static float store (float v) { return v; }
+};
+
+template<> struct PiPoValueCodec<PiPoStreamFormat::Float64>
+{
+  typedef double type;
+  static float load (double v) { return (float) v; }
+  static double store (float v) { return v; }
+};
+
+template<> struct PiPoValueCodec<PiPoStreamFormat::Int16>
+{
+  typedef short type;
+
+  static float load (short v) { return v * (1.0f / 32768.0f); }
+
+  static short store (float v)
+  { // saturate and round to nearest
+    float x = v * 32768.0f;
+
+    x = (x < -32768.0f)  ?  -32768.0f  :  ((x > 32767.0f)  ?  32767.0f  :  x);
+
+    return (short) (x + (x >= 0.0f  ?  0.5f  :  -0.5f));
+  }
+};
+
+template<> struct PiPoValueCodec<PiPoStreamFormat::Float16>
+{
+  typedef unsigned short type;
+
+  static float load (unsigned short h)
+  {
+    const unsigned int shiftedExp = 0x7c00 << 13; // exponent mask after shift
+    unsigned int o = (h & 0x7fff) << 13;          // exponent/mantissa bits
+    unsigned int exp = shiftedExp & o;
+    float f;
+
+    o += (127 - 15) << 23; // exponent adjust
+
+    if (exp == shiftedExp)
+      o += (128 - 16) << 23; // inf/nan
+    else if (exp == 0)
+    { // zero/denormal: renormalize
+      o += 1 << 23;
+      memcpy(&f, &o, sizeof(f));
+      f -= 6.10351563e-05f; // 2^-14
+      memcpy(&o, &f, sizeof(f));
+    }
+
+    o |= (h & 0x8000) << 16; // sign
+    memcpy(&f, &o, sizeof(f));
+
+    return f;
+  }
+
+  static unsigned short store (float v)
+  { // round to nearest even
+    unsigned int x;
+    unsigned int sign;
+    unsigned short h;
+
+    memcpy(&x, &v, sizeof(x));
+    sign = x & 0x80000000u;
+    x ^= sign;
+
+    if (x >= 0x47800000u) // overflow, inf or nan
+      h = (x > 0x7f800000u)  ?  0x7e00  :  0x7c00;
+    else if (x < 0x38800000u)
+    { // denormal or zero: let float addition do the rounding
+      float f;
+
+      memcpy(&f, &x, sizeof(f));
+      f += 0.5f;
+      memcpy(&x, &f, sizeof(f));
+      h = (unsigned short) (x - 0x3f000000u);
+    }
+    else
+    {
+      unsigned int odd = (x >> 13) & 1;
+
+      x += ((unsigned int) (15 - 127) << 23) + 0xfff + odd;
+      h = (unsigned short) (x >> 13);
+    }
+
+    return h | (unsigned short) (sign >> 16);
+  }
+};
+
+
+/**
+ * Conversion of a value from one type to another through float, values of the same type are copied unchanged
+ */
+template<int Src, int Dst> struct PiPoValueConversion
+{
+  static typename PiPoValueCodec<Dst>::type convert (typename PiPoValueCodec<Src>::type v) { return PiPoValueCodec<Dst>::store(PiPoValueCodec<Src>::load(v)); }
+};
+
+template<int Type> struct PiPoValueConversion<Type, Type>
+{ // no rounding through float (e.g. transposing doubles)
+  static typename PiPoValueCodec<Type>::type convert (typename PiPoValueCodec<Type>::type v) { return v; }
+};
+
+
+/**
+ * Converts blocks of frames from one stream format to another
+ */
+class PiPoFormatConverter
+{
+public:
+  /** side of the square tiles transposed at once, fitting the L1 cache for all value types */
+  static const unsigned int tileSize = 32;
+
+private:
+  PiPoStreamFormat from_;
+  PiPoStreamFormat to_;
+  unsigned int width_;
+  unsigned int height_;
+  PiPoAlignedBuffer buffer_; // output block
+  unsigned int size_;        // size of the frames of the last converted block
+  std::vector<unsigned int> sizes_; // sizes of each frame of the last densified or sparsified block
+
+  /** a 2D copy: rows x cols values, either row to row, or transposed (row to column) */
+  struct Job
+  {
+    const void *src;
+    void *dst;
+    unsigned int rows;
+    unsigned int cols;
+    size_t srcStride; // values between rows of src
+    size_t dstStride; // values between rows of dst (between columns if transposed)
+    bool transpose;
+  };
+
+public:
+  PiPoFormatConverter ()
+  : from_(), to_(), width_(0), height_(0), buffer_(), size_(0), sizes_()
+  { }
+
+  /**
+   * Prepare conversion of blocks of up to maxFrames frames of width x height values (not real-time safe)
+   *
+   * Resolves the strides of both formats, see getInputFormat() and getOutputFormat().
+   */
+  void setup (const PiPoStreamFormat &from, const PiPoStreamFormat &to, unsigned int width, unsigned int height, unsigned int maxFrames)
+  {
+    this->from_ = from;
+    this->to_ = to;
+    this->width_ = width;
+    this->height_ = height;
+    this->from_.resolve(width, height);
+    this->to_.resolve(width, height);
+
+    if (isActive())
+    {
+      size_t frameValues = (this->to_.layout == PiPoStreamFormat::Planar  ?  width * height  :  this->to_.frameStride);
+      size_t align = (this->to_.alignment > PiPoAlignedBuffer::defaultAlignment  ?  this->to_.alignment  :  PiPoAlignedBuffer::defaultAlignment);
+
+      this->buffer_.resize(maxFrames * frameValues * this->to_.getValueSize(), align);
+    }
+    else
+      this->buffer_.resize(0);
+
+    this->sizes_.resize(from.encoding != to.encoding  ?  maxFrames  :  0);
+  }
+
+  /** true if the input format doesn't satisfy the output format */
+  bool isActive () const
+  {
+    return !this->from_.satisfies(this->to_);
+  }
+
+  const PiPoStreamFormat &getInputFormat () const { return this->from_; }
+  const PiPoStreamFormat &getOutputFormat () const { return this->to_; }
+
+  /** size to pass on with the last converted block (changes when densifying or sparsifying) */
+  unsigned int getOutputSize () const { return this->size_; }
+
+  /** sizes to pass on with the last converted block of variable size frames, given their input \p sizes */
+  const unsigned int *getOutputSizes (const unsigned int *sizes) const
+  {
+    return this->from_.encoding != this->to_.encoding  ?  &this->sizes_[0]  :  sizes;
+  }
+
+  /** prepare packing of frames in format \p from (e.g. a strided view) to contiguous frames of the same value type and layout */
+  void setupPacking (const PiPoStreamFormat &from, unsigned int width, unsigned int height, unsigned int maxFrames)
+  {
+    setup(from, PiPoStreamFormat(from.valueType, from.layout), width, height, maxFrames);
+  }
+
+  /** the values as they are if no conversion is needed, otherwise the converted block (valid until the next call) */
+  const void *materialize (const void *values, unsigned int size, unsigned int num)
+  {
+    return isActive()  ?  convert(values, size, num)  :  values;
+  }
+
+  /** convert num frames, of which the first size values are valid, returns the converted block valid until the next call */
+  void *convert (const void *values, unsigned int size, unsigned int num)
+  {
+    const PiPoStreamFormat &from = this->from_;
+    const PiPoStreamFormat &to = this->to_;
+    void *out = this->buffer_.data();
+    unsigned int width = std::min(this->width_, size);
+    unsigned int rows = (this->width_ > 0  ?  (size + this->width_ - 1) / this->width_  :  0); // valid rows of varsize frames
+    size_t srcValueSize = from.getValueSize();
+    size_t dstValueSize = to.getValueSize();
+    Job job;
+
+    if (from.encoding != to.encoding)
+      return recode(values, size, num);
+
+    this->size_ = size;
+
+    if (from.layout == PiPoStreamFormat::Planar  &&  to.layout == PiPoStreamFormat::Planar)
+    { // one run of values (planes of invalid values of varsize frames are at the end)
+      job.src = values;
+      job.dst = out;
+      job.rows = 1;
+      job.cols = size * num;
+      job.srcStride = job.dstStride = 0;
+      job.transpose = false;
+      run(job, from.valueType, to.valueType);
+    }
+    else if (from.layout == PiPoStreamFormat::Interleaved  &&  to.layout == PiPoStreamFormat::Interleaved)
+    {
+      if (from.isPacked(this->width_, this->height_)  &&  to.isPacked(this->width_, this->height_)  &&  size == this->width_ * this->height_)
+      { // one run of values
+        job.src = values;
+        job.dst = out;
+        job.rows = 1;
+        job.cols = num * size;
+        job.srcStride = job.dstStride = 0;
+        job.transpose = false;
+        run(job, from.valueType, to.valueType);
+      }
+      else if (from.frameStride == from.rowStride * this->height_  &&  to.frameStride == to.rowStride * this->height_  &&  size == this->width_ * this->height_)
+      { // all rows of all frames at once
+        job.src = values;
+        job.dst = out;
+        job.rows = num * this->height_;
+        job.cols = this->width_;
+        job.srcStride = from.rowStride;
+        job.dstStride = to.rowStride;
+        job.transpose = false;
+        run(job, from.valueType, to.valueType);
+      }
+      else
+      { // frame by frame, leaving padding and invalid rows of varsize frames alone
+        for (unsigned int i = 0; i < num; i++)
+        {
+          job.src = (const char *) values + i * from.frameStride * srcValueSize;
+          job.dst = (char *) out + i * to.frameStride * dstValueSize;
+          job.rows = rows;
+          job.cols = this->width_;
+          job.srcStride = from.rowStride;
+          job.dstStride = to.rowStride;
+          job.transpose = false;
+          run(job, from.valueType, to.valueType);
+        }
+      }
+    }
+    else
+    { // transpose row by row of the frames: values of row r are planes r * width ... (r + 1) * width - 1
+      for (unsigned int r = 0; r < rows; r++)
+      {
+        if (from.layout == PiPoStreamFormat::Interleaved)
+        { // num frames x width values become width planes of num values
+          job.src = (const char *) values + r * from.rowStride * srcValueSize;
+          job.dst = (char *) out + r * this->width_ * num * dstValueSize;
+          job.rows = num;
+          job.cols = width;
+          job.srcStride = from.frameStride;
+          job.dstStride = num;
+        }
+        else
+        { // width planes of num values become num frames x width values
+          job.src = (const char *) values + r * this->width_ * num * srcValueSize;
+          job.dst = (char *) out + r * to.rowStride * dstValueSize;
+          job.rows = width;
+          job.cols = num;
+          job.srcStride = num;
+          job.dstStride = to.frameStride;
+        }
+
+        job.transpose = true;
+        run(job, from.valueType, to.valueType);
+      }
+    }
+
+    return out;
+  }
+
+  /** convert num values of type srcType at src to type dstType at dst */
+  static void convertValues (const void *src, enum PiPoStreamFormat::ValueType srcType, void *dst, enum PiPoStreamFormat::ValueType dstType, size_t num)
+  {
+    Job job = { src, dst, 1, (unsigned int) num, 0, 0, false };
+
+    run(job, srcType, dstType);
+  }
+
+  /** transpose rows x cols values at src to cols x rows values at dst, converting their type */
+  static void transposeValues (const void *src, enum PiPoStreamFormat::ValueType srcType, void *dst, enum PiPoStreamFormat::ValueType dstType, unsigned int rows, unsigned int cols)
+  {
+    Job job = { src, dst, rows, cols, cols, rows, true };
+
+    run(job, srcType, dstType);
+  }
+
+  /** interleave num values of each of numChannels float channels into frames starting every frameStride values at dst */
+  static void interleave (const float *const *channels, unsigned int numChannels, unsigned int num, float *dst, unsigned int frameStride)
+  {
+    for (unsigned int i0 = 0; i0 < num; i0 += tileSize)
+    {
+      unsigned int i1 = std::min(num, i0 + tileSize);
+
+      for (unsigned int c = 0; c < numChannels; c++)
+      {
+        const float *ch = channels[c];
+
+        for (unsigned int i = i0; i < i1; i++)
+          dst[i * frameStride + c] = ch[i];
+      }
+    }
+  }
+
+private:
+  /** densify sparse frames or sparsify dense frames, the dense frames being of any value type and layout */
+  void *recode (const void *values, unsigned int size, unsigned int num)
+  {
+    void *out = this->buffer_.data();
+
+    if (this->from_.encoding == PiPoStreamFormat::Sparse)
+    {
+      switch (this->to_.valueType)
+      {
+        case PiPoStreamFormat::Float32: densify<PiPoStreamFormat::Float32>(static_cast<const float *>(values), out, num); break;
+        case PiPoStreamFormat::Int16:   densify<PiPoStreamFormat::Int16>(static_cast<const float *>(values), out, num); break;
+        case PiPoStreamFormat::Float16: densify<PiPoStreamFormat::Float16>(static_cast<const float *>(values), out, num); break;
+        case PiPoStreamFormat::Float64: densify<PiPoStreamFormat::Float64>(static_cast<const float *>(values), out, num); break;
+        default: break;
+      }
+    }
+    else
+    {
+      switch (this->from_.valueType)
+      {
+        case PiPoStreamFormat::Float32: sparsify<PiPoStreamFormat::Float32>(values, size, static_cast<float *>(out), num); break;
+        case PiPoStreamFormat::Int16:   sparsify<PiPoStreamFormat::Int16>(values, size, static_cast<float *>(out), num); break;
+        case PiPoStreamFormat::Float16: sparsify<PiPoStreamFormat::Float16>(values, size, static_cast<float *>(out), num); break;
+        case PiPoStreamFormat::Float64: sparsify<PiPoStreamFormat::Float64>(values, size, static_cast<float *>(out), num); break;
+        default: break;
+      }
+    }
+
+    return out;
+  }
+
+  /** offset of element k (row * width + column) of frame i of a block of num dense frames */
+  size_t getDenseOffset (const PiPoStreamFormat &format, unsigned int k, unsigned int i, unsigned int num) const
+  {
+    if (format.layout == PiPoStreamFormat::Planar)
+      return (size_t) k * num + i;
+
+    return (size_t) i * format.frameStride + (k / this->width_) * format.rowStride + k % this->width_;
+  }
+
+  /** scatter the non-zero values of sparse frames into zeroed dense frames */
+  template<int Dense>
+  void densify (const float *src, void *out, unsigned int num)
+  {
+    typedef typename PiPoValueCodec<Dense>::type DenseType;
+    DenseType *dst = static_cast<DenseType *>(out);
+    unsigned int numValues = this->width_ * this->height_;
+    size_t blockValues = (this->to_.layout == PiPoStreamFormat::Planar  ?  (size_t) numValues * num  :  (size_t) this->to_.frameStride * num);
+
+    memset(dst, 0, blockValues * sizeof(DenseType)); // zero bits are zero for all value types
+
+    for (unsigned int i = 0; i < num; i++)
+    {
+      const float *frame = src + (size_t) i * this->from_.frameStride;
+      unsigned int count = (unsigned int) frame[0];
+
+      for (unsigned int j = 0; j < count; j++)
+      {
+        unsigned int k = (unsigned int) frame[1 + 2 * j];
+
+        if (k < numValues)
+          dst[getDenseOffset(this->to_, k, i, num)] = PiPoValueCodec<Dense>::store(frame[2 + 2 * j]);
+      }
+
+      this->sizes_[i] = numValues;
+    }
+
+    this->size_ = numValues;
+  }
+
+  /** gather the non-zero values among the first size values of dense frames into sparse frames */
+  template<int Dense>
+  void sparsify (const void *values, unsigned int size, float *dst, unsigned int num)
+  {
+    typedef typename PiPoValueCodec<Dense>::type DenseType;
+    const DenseType *src = static_cast<const DenseType *>(values);
+    unsigned int numValues = std::min(size, this->width_ * this->height_);
+
+    this->size_ = 1;
+
+    for (unsigned int i = 0; i < num; i++)
+    {
+      float *frame = dst + (size_t) i * this->to_.frameStride;
+      unsigned int count = 0;
+
+      for (unsigned int k = 0; k < numValues; k++)
+      {
+        float value = PiPoValueCodec<Dense>::load(src[getDenseOffset(this->from_, k, i, num)]);
+
+        if (value != 0.0f)
+        {
+          frame[1 + 2 * count] = (float) k;
+          frame[2 + 2 * count] = value;
+          count++;
+        }
+      }
+
+      frame[0] = (float) count;
+      this->sizes_[i] = 1 + 2 * count;
+      this->size_ = std::max(this->size_, this->sizes_[i]);
+    }
+  }
+
+  static void run (const Job &job, enum PiPoStreamFormat::ValueType srcType, enum PiPoStreamFormat::ValueType dstType)
+  {
+    if (srcType == dstType  &&  !job.transpose)
+    { // plain copy
+      size_t valueSize = PiPoStreamFormat::getValueSize(srcType);
+
+      for (unsigned int r = 0; r < job.rows; r++)
+        memcpy((char *) job.dst + r * job.dstStride * valueSize, (const char *) job.src + r * job.srcStride * valueSize, job.cols * valueSize);
+
+      return;
+    }
+
+    switch (srcType)
+    {
+      case PiPoStreamFormat::Float32: runFrom<PiPoStreamFormat::Float32>(job, dstType); break;
+      case PiPoStreamFormat::Int16:   runFrom<PiPoStreamFormat::Int16>(job, dstType); break;
+      case PiPoStreamFormat::Float16: runFrom<PiPoStreamFormat::Float16>(job, dstType); break;
+      case PiPoStreamFormat::Float64: runFrom<PiPoStreamFormat::Float64>(job, dstType); break;
+      default: break;
+    }
+  }
+
+  template<int Src>
+  static void runFrom (const Job &job, enum PiPoStreamFormat::ValueType dstType)
+  {
+    switch (dstType)
+    {
+      case PiPoStreamFormat::Float32: runLoop<Src, PiPoStreamFormat::Float32>(job); break;
+      case PiPoStreamFormat::Int16:   runLoop<Src, PiPoStreamFormat::Int16>(job); break;
+      case PiPoStreamFormat::Float16: runLoop<Src, PiPoStreamFormat::Float16>(job); break;
+      case PiPoStreamFormat::Float64: runLoop<Src, PiPoStreamFormat::Float64>(job); break;
+      default: break;
+    }
+  }
+
+  template<int Src, int Dst>
+  static void runLoop (const Job &job)
+  {
+    typedef typename PiPoValueCodec<Src>::type SrcType;
+    typedef typename PiPoValueCodec<Dst>::type DstType;
+    const SrcType *src = static_cast<const SrcType *>(job.src);
+    DstType *dst = static_cast<DstType *>(job.dst);
+
+    if (!job.transpose)
+    {
+      for (unsigned int r = 0; r < job.rows; r++)
+        convertLoop<Src, Dst>(src + r * job.srcStride, dst + r * job.dstStride, job.cols);
+    }
+    else
+    { // transpose tile by tile, so that both source rows and destination rows stay in cache
+      for (unsigned int r0 = 0; r0 < job.rows; r0 += tileSize)
+      {
+        unsigned int r1 = std::min(job.rows, r0 + tileSize);
+
+        for (unsigned int c0 = 0; c0 < job.cols; c0 += tileSize)
+        {
+          unsigned int c1 = std::min(job.cols, c0 + tileSize);
+
+          for (unsigned int c = c0; c < c1; c++)
+          {
+            DstType *out = dst + c * job.dstStride;
+
+            for (unsigned int r = r0; r < r1; r++)
+              out[r] = PiPoValueConversion<Src, Dst>::convert(src[r * job.srcStride + c]);
+          }
+        }
+      }
+    }
+  }
+
+  /** simple loop through float, for the compiler to vectorize */
+  template<int Src, int Dst>
+  static void convertLoop (const typename PiPoValueCodec<Src>::type *in, typename PiPoValueCodec<Dst>::type *out, size_t num)
+  {
+    size_t i = 0;
+
+#if defined(__F16C__)
+    if (Src == PiPoStreamFormat::Float32  &&  Dst == PiPoStreamFormat::Float16)
+    {
+      for (; i + 8 <= num; i += 8)
+        _mm_storeu_si128((__m128i *) ((unsigned short *) out + i), _mm256_cvtps_ph(_mm256_loadu_ps((const float *) in + i), 0));
+    }
+    else if (Src == PiPoStreamFormat::Float16  &&  Dst == PiPoStreamFormat::Float32)
+    {
+      for (; i + 8 <= num; i += 8)
+        _mm256_storeu_ps((float *) out + i, _mm256_cvtph_ps(_mm_loadu_si128((const __m128i *) ((const unsigned short *) in + i))));
+    }
+#endif
+
+    for (; i < num; i++)
+      out[i] = PiPoValueConversion<Src, Dst>::convert(in[i]);
+  }
+};
+
+/** EMACS **
+ * Local variables:
+ * mode: c++
+ * c-basic-offset:2
+ * End:
+ */
+
+#endif /* _PIPO_STREAM_FORMAT_ */
@@ -27,12 +27,20 @@ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
 #ifndef _RINGBUFFER_
 #define _RINGBUFFER_
 
+/** ring of size frames of width values
+ *
+ *  With an alignment given to resize(), each frame starts at an aligned address
+ *  and is padded with zeros to stride values (see getFrame()).
+ *  Without, frames are packed in vector.
+ */
 template <class T>
 class RingBuffer
 {
 public:
   std::vector<T> vector;
   unsigned int width;
+  unsigned int stride;    // values between frames (width padded to alignment)
+  unsigned int alignment; // alignment of frames in bytes (0 for packed frames at start of vector)
   unsigned int size;
   unsigned int index;
   bool filled;
@@ -42,19 +50,41 @@ public:
   : vector()
   {
     this->width = 1;
+    this->stride = 1;
+    this->alignment = 0;
     this->size = 0;
     this->index = 0;
     this->filled = false;  
   };
     
-  void resize (int width, int size)
+  void resize (int width, int size, unsigned int alignment = 0)
   {
-    this->vector.resize(width * size);
+    if (alignment > sizeof(T))
+      this->stride = (unsigned int) ((width * sizeof(T) + alignment - 1) / alignment * alignment / sizeof(T));
+    else
+    {
+      this->stride = width;
+      alignment = 0;
+    }
+
+    this->vector.assign(this->stride * size + alignment / sizeof(T), T()); // padding stays zero
     this->width = width;
+    this->alignment = alignment;
     this->size = size;
     this->index = 0;
     this->filled = false;
   };
+
+  /** frame i of the ring (aligned if an alignment was given) */
+  T *getFrame (unsigned int i)
+  {
+    T *data = &this->vector[0];
+
+    if (this->alignment > 0)
+      data = (T *) ((char *) data + (this->alignment - ((size_t) data) % this->alignment) % this->alignment);
+
+    return data + i * this->stride;
+  }
     
   void reset (void)
   {
@@ -64,7 +94,7 @@ public:
     
   int input (T *values, unsigned int num, PiPoValue scale = 1.0)
   {  
-    T *ringValues = &this->vector[this->index * this->width];
+    T *ringValues = getFrame(this->index);
       
     if (num > this->width)
       num = this->width;
@@ -0,0 +1,161 @@
+/**
+ * @file PiPoAttrQueue.h
+ *
+ * @brief Lock-free queue of attribute changes applied by the processing thread.
+ *
+ * The control thread pushes the changes of stream attributes (attributes whose
+ * change requires a reconfiguration of the graph), one group of commands per
+ * change, and the thread running the graph applies them at the next block
+ * boundary, or, for scheduled changes, at the frame of their time.  The queue
+ * has a single producer and a single consumer.  Values that don't fit in a command (strings,
+ * arrays) are kept by the producer and freed once the consumer has applied the command
+ * (see consumed()).
+ *
+ * @copyright
+ * Copyright (c) 2012–2016 by IRCAM – Centre Pompidou, Paris, France.
+ * All rights reserved.
+ *
+ * License (BSD 3-clause)
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef _PIPO_ATTR_QUEUE_
+#define _PIPO_ATTR_QUEUE_
+
+#include "PiPo.h"
+
+#include <atomic>
+#include <vector>
+
+/** change of one value, or of a span of values, of an attribute */
+struct PiPoAttrCommand
+{
+  enum Kind { SetInt, SetDouble, SetString, SetInts, SetDoubles };
+
+  PiPo::Attr *attr;
+  enum Kind kind;
+  unsigned int index;     // element index (of the first value)
+  unsigned int num;       // number of values of SetInts and SetDoubles
+  bool scheduled;         // apply at the frame of time instead of the next block
+  double time;            // stream time in ms
+  union
+  {
+    int i;
+    double d;
+    const char *s;        // must stay valid until applied
+    const int *ints;      // must stay valid until applied
+    const double *dbls;   // must stay valid until applied
+  } value;
+};
+
+class PiPoAttrQueue
+{
+private:
+  std::vector<PiPoAttrCommand> commands_;
+  size_t mask_;
+  std::atomic<size_t> head_;  // end of committed commands (written by producer)
+  std::atomic<size_t> tail_;  // next command to apply (written by consumer)
+  size_t staged_;             // end of commands pushed but not committed (producer only)
+
+public:
+  /** capacity is rounded up to a power of two */
+  PiPoAttrQueue (size_t capacity = 1024)
+  : commands_(), mask_(0), head_(0), tail_(0), staged_(0)
+  {
+    size_t size = 2;
+
+    while (size < capacity)
+      size <<= 1;
+
+    commands_.resize(size);
+    mask_ = size - 1;
+  }
+
+  PiPoAttrQueue (const PiPoAttrQueue &other) = delete;
+  PiPoAttrQueue &operator= (const PiPoAttrQueue &other) = delete;
+
+  /** add command to the current group (control thread), returns false when the queue is full */
+  bool push (const PiPoAttrCommand &command)
+  {
+    if (staged_ - tail_.load(std::memory_order_acquire) > mask_)
+      return false;
+
+    commands_[staged_ & mask_] = command;
+    staged_++;
+
+    return true;
+  }
+
+  /** make the current group of commands visible to the processing thread */
+  void commit ()
+  {
+    head_.store(staged_, std::memory_order_release);
+  }
+
+  /** drop the current group of commands (e.g. when it didn't fit) */
+  void abort ()
+  {
+    staged_ = head_.load(std::memory_order_relaxed);
+  }
+
+  /** oldest committed command (processing thread), NULL when there is none */
+  const PiPoAttrCommand *front ()
+  {
+    size_t tail = tail_.load(std::memory_order_relaxed);
+
+    if (tail == head_.load(std::memory_order_acquire))
+      return NULL;
+
+    return &commands_[tail & mask_];
+  }
+
+  /** take out the oldest command once it has been applied (processing thread) */
+  void pop ()
+  {
+    tail_.store(tail_.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+  }
+
+  /** position of the next command pushed (control thread) */
+  size_t pushed () const
+  {
+    return staged_;
+  }
+
+  /** number of commands applied, commands at lower positions don't use their values anymore (control thread) */
+  size_t consumed () const
+  {
+    return tail_.load(std::memory_order_acquire);
+  }
+};
+
+/** EMACS **
+ * Local variables:
+ * mode: c++
+ * c-basic-offset:2
+ * End:
+ */
+
+#endif /* _PIPO_ATTR_QUEUE_ */
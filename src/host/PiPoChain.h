@@ -55,6 +55,7 @@
 
 #include "PiPoOp.h"
 #include "PiPoSequence.h"
+#include "PiPoMemoryPlanner.h"
 
 #include <string>
 #include <vector>
@@ -68,6 +69,7 @@ class PiPoChain : public PiPoSequence
   std::vector<std::string *> attrDescrs;
   //PiPo::Parent *parent; //FIXME: remove? pipo has a parent member already!
   PiPoModuleFactory *moduleFactory;
+  PiPoMemoryPlanner memoryPlanner; // places the modules' buffers in one arena
 
 public:
   // constructor
@@ -249,12 +251,36 @@ public:
     return NULL;
   }
 
+  /** memory planner placing the buffers of the chain's modules, to set its options */
+  PiPoMemoryPlanner &getMemoryPlanner()
+  {
+    return this->memoryPlanner;
+  }
+
   /** @} PiPoChain query methods */
 
   /** @name overloaded PiPo methods */
   /** @{ */
-  /** @name all preparation and processing methods are inherited from PiPoSequence:
-      streamAttributes(), reset(), frames(), finalize() */
+
+  /** propagate stream attributes through the sequence, then place the buffers declared by the modules
+      (unless an enclosing chain does it) */
+  int streamAttributes(bool hasTimeTags, double rate, double offset, unsigned int width, unsigned int height, const char **labels, bool hasVarSize, double domain, unsigned int maxFrames)
+  {
+    bool plan = (this->getBufferPlanner() == NULL  ||  this->getBufferPlanner() == &this->memoryPlanner);
+
+    if(plan)
+      this->memoryPlanner.attach(this);
+
+    int ret = PiPoSequence::streamAttributes(hasTimeTags, rate, offset, width, height, labels, hasVarSize, domain, maxFrames);
+
+    if(plan  &&  ret >= 0)
+      this->memoryPlanner.plan(this);
+
+    return ret;
+  }
+
+  /** @name all other preparation and processing methods are inherited from PiPoSequence:
+      reset(), frames(), finalize() */
   /** @} end of overloaded PiPo methods */
 };
 
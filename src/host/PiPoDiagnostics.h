@@ -0,0 +1,171 @@
+/**
+ * @file PiPoDiagnostics.h
+ *
+ * @brief Lock-free queue of the diagnostics posted by the modules of a graph.
+ *
+ * Modules post diagnostics from any thread, in particular from frames() on the
+ * audio thread, with PiPo::postDiagnostic().  The host queues them into a ring
+ * of preallocated records without locking or allocating, and non real-time
+ * threads take them out to format and output them.  When the ring is full, the
+ * diagnostics are dropped and counted.
+ *
+ * @copyright
+ * Copyright (c) 2012–2016 by IRCAM – Centre Pompidou, Paris, France.
+ * All rights reserved.
+ *
+ * License (BSD 3-clause)
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef _PIPO_DIAGNOSTICS_
+#define _PIPO_DIAGNOSTICS_
+
+#include "PiPo.h"
+
+#include <atomic>
+#include <cstdint>
+
+class PiPoDiagnosticRing
+{
+private:
+  /** record with its sequence number telling whether it is free or filled */
+  struct Slot
+  {
+    std::atomic<size_t> sequence;
+    PiPoDiagnostic diagnostic;
+  };
+
+  Slot *slots_;
+  size_t mask_;
+  std::atomic<size_t> head_;   // next position to fill
+  std::atomic<size_t> tail_;   // next position to take out
+  std::atomic<unsigned int> dropped_;
+
+public:
+  /** capacity is rounded up to a power of two */
+  PiPoDiagnosticRing (size_t capacity = 256)
+  : slots_(NULL), mask_(0), head_(0), tail_(0), dropped_(0)
+  {
+    size_t size = 2;
+
+    while (size < capacity)
+      size <<= 1;
+
+    slots_ = new Slot[size];
+    mask_ = size - 1;
+
+    for (size_t i = 0; i < size; i++)
+      slots_[i].sequence.store(i, std::memory_order_relaxed);
+  }
+
+  ~PiPoDiagnosticRing ()
+  {
+    delete [] slots_;
+  }
+
+  PiPoDiagnosticRing (const PiPoDiagnosticRing &other) = delete;
+  PiPoDiagnosticRing &operator= (const PiPoDiagnosticRing &other) = delete;
+
+  size_t getCapacity () const { return mask_ + 1; }
+
+  /** queue diagnostic (from any thread, lock-free), returns false and counts the diagnostic as dropped when the ring is full */
+  bool push (const PiPoDiagnostic &diagnostic)
+  {
+    size_t pos = head_.load(std::memory_order_relaxed);
+    Slot *slot;
+
+    for (;;)
+    {
+      slot = &slots_[pos & mask_];
+
+      size_t seq = slot->sequence.load(std::memory_order_acquire);
+      intptr_t diff = (intptr_t) seq - (intptr_t) pos;
+
+      if (diff == 0)
+      {
+        if (head_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+          break;
+      }
+      else if (diff < 0)
+      { // full
+        dropped_.fetch_add(1, std::memory_order_relaxed);
+        return false;
+      }
+      else
+        pos = head_.load(std::memory_order_relaxed);
+    }
+
+    slot->diagnostic = diagnostic;
+    slot->sequence.store(pos + 1, std::memory_order_release);
+
+    return true;
+  }
+
+  /** take out the oldest diagnostic (from any thread, lock-free), returns false when the ring is empty */
+  bool pop (PiPoDiagnostic &diagnostic)
+  {
+    size_t pos = tail_.load(std::memory_order_relaxed);
+    Slot *slot;
+
+    for (;;)
+    {
+      slot = &slots_[pos & mask_];
+
+      size_t seq = slot->sequence.load(std::memory_order_acquire);
+      intptr_t diff = (intptr_t) seq - (intptr_t) (pos + 1);
+
+      if (diff == 0)
+      {
+        if (tail_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+          break;
+      }
+      else if (diff < 0)
+        return false; // empty
+      else
+        pos = tail_.load(std::memory_order_relaxed);
+    }
+
+    diagnostic = slot->diagnostic;
+    slot->sequence.store(pos + mask_ + 1, std::memory_order_release);
+
+    return true;
+  }
+
+  /** number of diagnostics dropped since the last call */
+  unsigned int takeDropped ()
+  {
+    return dropped_.exchange(0, std::memory_order_relaxed);
+  }
+};
+
+/** EMACS **
+ * Local variables:
+ * mode: c++
+ * c-basic-offset:2
+ * End:
+ */
+
+#endif /* _PIPO_DIAGNOSTICS_ */
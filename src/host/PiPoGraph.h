@@ -56,6 +56,7 @@
 #include "PiPoOp.h"
 #include "PiPoSequence.h"
 #include "PiPoParallel.h"
+#include "PiPoMemoryPlanner.h"
 
 // NB : this is a work in progress
 // TODO: define error return codes for parsing
@@ -85,6 +86,9 @@ private:
   std::vector<std::string *> attrDescrs;
   PiPoModuleFactory *moduleFactory;
 
+  // places the buffers of all modules in one arena (used by top level graph only)
+  PiPoMemoryPlanner memoryPlanner;
+
 public:
   PiPoGraph(PiPo::Parent *parent, PiPoModuleFactory *moduleFactory, bool topLevel = true) :
   PiPo(parent)
@@ -334,6 +338,28 @@ private:
     return false;
   }
 
+  //=========================== FIND MODULE IN GRAPH ==========================//
+
+  // find module in the graph, with restart telling the parallel sections on the way which branch restarts
+  bool findModule(PiPo *module, bool restart)
+  {
+    if (this->graphType == leaf)
+      return this->pipo == module;
+
+    for (unsigned int i = 0; i < this->subGraphs.size(); ++i)
+    {
+      if (this->subGraphs[i].findModule(module, restart))
+      {
+        if (restart && this->graphType == parallel)
+          static_cast<PiPoParallel *>(this->pipo)->restartBranch(i);
+
+        return true;
+      }
+    }
+
+    return false;
+  }
+
   //================ ONCE EXPRESSION PARSED, INSTANTIATE OPs =================//
 
   bool instantiate()
@@ -449,6 +475,11 @@ public:
     return this->pipo;
   }
 
+  PiPoMemoryPlanner &getMemoryPlanner()
+  {
+    return this->memoryPlanner;
+  }
+
   //=============== OVERRIDING ALL METHODS FROM THE BASE CLASS ===============//
 
   void setParent(PiPo::Parent *parent) override
@@ -469,6 +500,50 @@ public:
     this->pipo->setReceiver(receiver);
   }
 
+  // tiled execution of large blocks when the graph is a sequence (see PiPoSequence::setTileSize())
+  bool setTileSize(unsigned int numFrames)
+  {
+    if (this->graphType == sequence && this->pipo != nullptr)
+    {
+      static_cast<PiPoSequence *>(this->pipo)->setTileSize(numFrames);
+      return true;
+    }
+
+    return false;
+  }
+
+  // true if module is a module of the graph that can be reconfigured from its last input stream attributes
+  bool canRestartStreamAttributes(PiPo *module)
+  {
+    return this->findModule(module, false) && module->canRestartStreamAttributes();
+  }
+
+  // reconfigure module and the modules after it only (when module's attributes changed), instead of the whole graph
+  int restartStreamAttributes(PiPo *module)
+  {
+    if (!this->canRestartStreamAttributes(module))
+      return -1;
+
+    this->findModule(module, true);
+    int ret = module->restartStreamAttributes();
+
+    // only the buffers declared again are placed, the others keep their offset and contents
+    if (this->topLevel && ret >= 0)
+      this->memoryPlanner.plan(this);
+
+    return ret;
+  }
+
+  void visitBuffers(PiPo::BufferVisitor &visitor) override
+  {
+    this->pipo->visitBuffers(visitor);
+  }
+
+  void negotiateInputFormat(PiPoStreamFormat &format) override
+  {
+    this->pipo->negotiateInputFormat(format);
+  }
+
   int reset() override
   {
     return this->pipo->reset();
@@ -489,17 +564,43 @@ public:
                                const char **labels, bool hasVarSize,
                                double domain, unsigned int maxFrames) override
   {
-    return this->pipo->streamAttributes(hasTimeTags, rate, offset,
-                                           width, height, labels, hasVarSize,
-                                           domain, maxFrames);
+    if (this->topLevel)
+      this->memoryPlanner.attach(this);
+
+    this->pipo->setInputWritable(this->isInputWritable());
+    this->pipo->setInputFormat(this->getInputFormat());
+    int ret = this->pipo->receiveStreamAttributes(hasTimeTags, rate, offset,
+                                                  width, height, labels, hasVarSize,
+                                                  domain, maxFrames);
+
+    // after propagation, all module buffers are known
+    if (this->topLevel && ret >= 0)
+      this->memoryPlanner.plan(this);
+
+    return ret;
   }
 
   int frames (double time, double weight, PiPoValue *values,
                       unsigned int size, unsigned int num) override
   {
+    this->pipo->setInputActivity(this->getInputActivity());
     return this->pipo->frames(time, weight, values, size, num);
   }
 
+  int framesTimeTagged (const double *times, double weight, PiPoValue *values,
+                        unsigned int size, unsigned int num) override
+  {
+    this->pipo->setInputActivity(this->getInputActivity());
+    return this->pipo->framesTimeTagged(times, weight, values, size, num);
+  }
+
+  int framesVarSize (const double *times, double weight, PiPoValue *values,
+                     const unsigned int *sizes, unsigned int num) override
+  {
+    this->pipo->setInputActivity(this->getInputActivity());
+    return this->pipo->framesVarSize(times, weight, values, sizes, num);
+  }
+
   // void print() {
   //   std::cout << this->representation << " " << this->graphType << std::endl;
   //   for (unsigned int i = 0; i < this->subGraphs.size(); ++i) {
@@ -41,9 +41,17 @@
 #define PIPO_OUT_RING_SIZE 2
 
 #include <iostream>
+#include <fstream>
+#include <sstream>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <algorithm>
 
 #include "PiPoHost.h"
 #include "PiPoCollection.h"
+#include "PiPoGraph.h"
 
 //================================= PiPoHost =================================//
 
@@ -52,8 +60,23 @@
 
 PiPoHost::PiPoHost() :
 inputStreamAttrs(PIPO_MAX_LABELS),
-outputStreamAttrs(PIPO_MAX_LABELS)
+outputStreamAttrs(PIPO_MAX_LABELS),
+skipUnchanged(false),
+tileSize(0),
+calibrating(false),
+diagnostics(256),
+diagnosticLevel(PiPoDiagnostic::Info),
+queueAttrs(false),
+attrQueue(1024),
+scheduledAttrs(),
+scheduledPending(0),
+attrTransactionDepth(0),
+attrTransactionChanged(false),
+attrTransactionModule(nullptr),
+attrTransactionFailed(false),
+attrIndex()
 {
+  this->scheduledAttrs.reserve(1024);
   PiPoCollection::init();
   this->out = new PiPoOut(this);
   this->graph = nullptr;
@@ -69,99 +92,1075 @@ PiPoHost::~PiPoHost()
 void
 PiPoHost::streamAttributesChanged(PiPo *pipo, PiPo::Attr *attr)
 {
+  if (this->attrTransactionDepth > 0)
+  {
+    this->attrTransactionModule = (!this->attrTransactionChanged || this->attrTransactionModule == pipo) ? pipo : nullptr;
+    this->attrTransactionChanged = true;
+    return;
+  }
+
+  this->reconfigure(pipo);
+  this->drainDiagnostics();
+}
+
+void
+PiPoHost::signalError(PiPo *pipo, std::string errorMsg)
+{
+  PiPoDiagnostic diagnostic(PiPoDiagnostic::Message, PiPoDiagnostic::Error, pipo);
+
+  diagnostic.setText(errorMsg.c_str());
+  this->postDiagnostic(pipo, diagnostic);
+}
+
+void
+PiPoHost::signalWarning(PiPo *pipo, std::string errorMsg)
+{
+  PiPoDiagnostic diagnostic(PiPoDiagnostic::Message, PiPoDiagnostic::Warning, pipo);
+
+  diagnostic.setText(errorMsg.c_str());
+  this->postDiagnostic(pipo, diagnostic);
+}
+
+// queue without blocking, may be called from the thread running the graph
+void
+PiPoHost::postDiagnostic(PiPo *pipo, const PiPoDiagnostic &diagnostic)
+{
+  if (diagnostic.severity >= this->diagnosticLevel)
+    this->diagnostics.push(diagnostic);
+}
+
+unsigned int
+PiPoHost::drainDiagnostics()
+{
+  PiPoDiagnostic diagnostic;
+  unsigned int num = 0;
+  unsigned int dropped;
+
+  while (this->diagnostics.pop(diagnostic))
+  {
+    this->onDiagnostic(diagnostic);
+    num++;
+  }
+
+  dropped = this->diagnostics.takeDropped();
+
+  if (dropped > 0)
+  {
+    PiPoDiagnostic overflow(PiPoDiagnostic::Overflow, PiPoDiagnostic::Warning, nullptr, "%g diagnostics dropped");
+
+    overflow.values[0] = dropped;
+    this->onDiagnostic(overflow);
+    num++;
+  }
+
+  return num;
+}
+
+// override this method when inheriting
+void
+PiPoHost::onDiagnostic(const PiPoDiagnostic &diagnostic)
+{
+  char str[256];
+
+  std::cerr << PiPoDiagnostic::getSeverityName(diagnostic.severity) << " : "
+            << diagnostic.to_string(str, sizeof(str)) << std::endl;
+}
+
+void
+PiPoHost::setDiagnosticLevel(PiPoDiagnostic::Severity level)
+{
+  this->diagnosticLevel = level;
+}
+
+// own methods
+bool
+PiPoHost::setGraph(std::string name)
+{
+  this->discardQueuedAttrs();
+  this->drainDiagnostics(); // no diagnostics of deleted modules left in the ring
+
+  if (this->graph != nullptr)
+  {
+    delete this->graph;
+  }
+
+  this->graph = PiPoCollection::create(name, static_cast<PiPo::Parent *>(this));
+  this->indexAttrs();
+
+  if (this->graph != nullptr)
+  {
+    PiPoGraph *pipoGraph = dynamic_cast<PiPoGraph *>(this->graph);
+
+    // the modules take their scratch memory from the host's arena instead of one per graph
+    if (pipoGraph != nullptr)
+    {
+      pipoGraph->getMemoryPlanner().setSharedScratch(true);
+    }
+
+    this->graphName = name;
+    this->graph->setReceiver((PiPo *)this->out);
+    return true;
+  }
+
+  this->graph = nullptr;
+  this->graphName = "undefined";
+  return false;
+}
+
+void
+PiPoHost::clearGraph()
+{
+  this->discardQueuedAttrs();
+  this->drainDiagnostics(); // no diagnostics of deleted modules left in the ring
+
+  if (this->graph != nullptr)
+  {
+    delete this->graph;
+    this->graph = nullptr;
+  }
+
+  this->attrIndex.clear();
+}
+
+// override this method when inheriting !!!
+// void
+// PiPoHost::onNewFrame(std::function<void (double, double, PiPoValue *, unsigned int)> f)
+// {
+//   this->frameCallback = f;
+// }
+
+// override this method when inheriting !!!
+void
+PiPoHost::onNewFrame(double time, double weight, PiPoValue *values, unsigned int size)
+{
+  std::cout << time << std::endl;
+  std::cout << "please override this method" << std::endl;
+}
+
+std::vector<PiPoValue>
+PiPoHost::getLastFrame()
+{
+  return this->out->getLastFrame();
+}
+
+int
+PiPoHost::setInputStreamAttributes(const PiPoStreamAttributes &sa, bool propagate)
+{
+  this->inputStreamAttrs = sa;
+
+  if (propagate)
+  {
+    int ret = this->propagateInputStreamAttributes();
+
+    this->drainDiagnostics();
+    return ret;
+  }
+
+  return 0;
+}
+
+PiPoStreamAttributes&
+PiPoHost::getOutputStreamAttributes()
+{
+  return this->outputStreamAttrs;
+}
+
+int
+PiPoHost::frames(double time, double weight, PiPoValue *values, unsigned int size,
+                 unsigned int num)
+{
+  // queued and scheduled attribute changes
+  int ret = this->applyQueuedAttrs();
+
+  if (ret < 0)
+  {
+    return ret;
+  }
+
+  return this->inputFrames(time, weight, values, size, num);
+}
+
+int
+PiPoHost::frames(double time, double weight, const void *values, unsigned int size,
+                 unsigned int num)
+{
+  // queued and scheduled attribute changes
+  int ret = this->applyQueuedAttrs();
+
+  if (ret < 0)
+  {
+    return ret;
+  }
+
+  return this->inputFrames(time, weight, values, size, num);
+}
+
+// block in the input format, converted for the graph if needed (the block's queued changes are applied)
+int
+PiPoHost::inputFrames(double time, double weight, const void *values, unsigned int size, unsigned int num)
+{
+  if (this->inputConverter.isActive())
+  {
+    values = this->inputConverter.convert(values, size, num);
+    size = this->inputConverter.getOutputSize();
+  }
+
+  return this->graphFrames(time, weight, static_cast<PiPoValue *>(const_cast<void *>(values)), size, num);
+}
+
+int
+PiPoHost::frames(double time, double weight, PiPoValue **channels, unsigned int numChannels,
+                 unsigned int num)
+{
+  // queued and scheduled attribute changes
+  int ret = this->applyQueuedAttrs();
+
+  if (ret < 0)
+  {
+    return ret;
+  }
+
+  const PiPoStreamFormat &format = this->graph->getInputFormat();
+  PiPoValue *block = static_cast<PiPoValue *>(this->planarBuffer.data());
+
+  if (format.valueType == PiPoStreamFormat::Float32 && format.layout == PiPoStreamFormat::Interleaved &&
+      format.encoding == PiPoStreamFormat::Dense && format.alignment <= PiPoAlignedBuffer::defaultAlignment)
+  {
+    // the graph takes interleaved floats: transpose directly from the channels, with its padding
+    PiPoFormatConverter::interleave(channels, numChannels, num, block, format.frameStride);
+    return this->graphFrames(time, weight, block, numChannels, num);
+  }
+
+  // gather channels into one planar block, converted to the graph's format if needed
+  for (unsigned int i = 0; i < numChannels; ++i)
+  {
+    std::memcpy(block + i * num, channels[i], num * sizeof(PiPoValue));
+  }
+
+  if (this->planarConverter.isActive())
+  {
+    block = static_cast<PiPoValue *>(this->planarConverter.convert(block, numChannels, num));
+    return this->graphFrames(time, weight, block, this->planarConverter.getOutputSize(), num);
+  }
+
+  return this->graphFrames(time, weight, block, numChannels, num);
+}
+
+int
+PiPoHost::frames(double time, double weight, PiPoValue *values, unsigned int size,
+                 unsigned int num, unsigned int activity)
+{
+  if (this->skipUnchanged && (activity & PiPo::ActivityUnchanged) != 0)
+  {
+    // the graph doesn't run, but queued changes and the scheduled changes due in the block still apply
+    int ret = this->applyQueuedAttrs();
+
+    if (ret < 0)
+    {
+      return ret;
+    }
+
+    double period = (!this->inputStreamAttrs.hasTimeTags && this->inputStreamAttrs.rate > 0) ? 1000.0 / this->inputStreamAttrs.rate : 0;
+    double end = time + (num > 0 ? num - 1 : 0) * period;
+
+    return this->applyDueAttrs(end, 1e-6 * period);
+  }
+
+  this->graph->setInputActivity(activity);
+  int ret = this->frames(time, weight, values, size, num);
+  this->graph->setInputActivity(PiPo::ActivityUnknown);
+
+  return ret;
+}
+
+void
+PiPoHost::setSkipUnchanged(bool skip)
+{
+  this->skipUnchanged = skip;
+}
+
+int
+PiPoHost::framesTimeTagged(const double *times, double weight, PiPoValue *values, unsigned int size,
+                           unsigned int num)
+{
+  // queued and scheduled attribute changes
+  int ret = this->applyQueuedAttrs();
+
+  if (ret < 0)
+  {
+    return ret;
+  }
+
+  if (this->inputConverter.isActive())
+  {
+    values = static_cast<PiPoValue *>(this->inputConverter.convert(values, size, num));
+    size = this->inputConverter.getOutputSize();
+  }
+
+  return this->graphFramesTimeTagged(times, weight, values, size, num);
+}
+
+int
+PiPoHost::framesVarSize(const double *times, double weight, PiPoValue *values,
+                        const unsigned int *sizes, unsigned int num)
+{
+  // queued and scheduled attribute changes
+  int ret = this->applyQueuedAttrs();
+
+  if (ret < 0)
+  {
+    return ret;
+  }
+
+  if (this->inputConverter.isActive())
+  {
+    // convert all valid rows, up to the largest frame
+    unsigned int maxSize = 0;
+
+    for (unsigned int i = 0; i < num; ++i)
+    {
+      maxSize = std::max(maxSize, sizes[i]);
+    }
+
+    values = static_cast<PiPoValue *>(this->inputConverter.convert(values, maxSize, num));
+    sizes = this->inputConverter.getOutputSizes(sizes);
+  }
+
+  return this->graphFramesVarSize(times, weight, values, sizes, num);
+}
+
+static bool
+setGraphTileSize(PiPo *graph, unsigned int numFrames)
+{
+  PiPoGraph *pipoGraph = dynamic_cast<PiPoGraph *>(graph);
+
+  if (pipoGraph != nullptr)
+  {
+    return pipoGraph->setTileSize(numFrames);
+  }
+
+  PiPoSequence *sequence = dynamic_cast<PiPoSequence *>(graph);
+
+  if (sequence != nullptr)
+  {
+    sequence->setTileSize(numFrames);
+    return true;
+  }
+
+  return false;
+}
+
+bool
+PiPoHost::setTileSize(unsigned int numFrames, bool propagate)
+{
+  this->tileSize = numFrames;
+  this->tuning[this->getTuningKey()] = numFrames;
+
+  if (propagate)
+  {
+    return this->propagateInputStreamAttributes() >= 0;
+  }
+
+  return true;
+}
+
+unsigned int
+PiPoHost::getTileSize()
+{
+  return this->tileSize;
+}
+
+unsigned int
+PiPoHost::autotune(const PiPoValue *input, unsigned int numFrames, unsigned int repetitions)
+{
+  if (this->graph == nullptr)
+  {
+    return 0;
+  }
+
+  const PiPoStreamFormat &format = this->inputStreamAttrs.format;
+  unsigned int frameSize = this->inputStreamAttrs.dims[0] * this->inputStreamAttrs.dims[1];
+  unsigned int maxFrames = std::max(this->inputStreamAttrs.maxFrames, 1u);
+  size_t frameBytes = frameSize * format.getValueSize();
+  double period = this->inputStreamAttrs.rate > 0 ? 1000.0 / this->inputStreamAttrs.rate : 0;
+  std::vector<char> noise;
+  std::string key = this->getTuningKey();
+
+  if (numFrames == 0)
+  {
+    numFrames = std::max(16 * maxFrames, 4096u);
+  }
+
+  if (input == NULL)
+  {
+    // uniform noise in [-1, 1[, in the input value type
+    std::vector<PiPoValue> values(numFrames * frameSize);
+    unsigned int seed = 1;
+
+    for (unsigned int i = 0; i < values.size(); ++i)
+    {
+      seed = seed * 1664525u + 1013904223u;
+      values[i] = (PiPoValue) ((seed >> 8) * (2.0 / 16777216.0) - 1.0);
+    }
+
+    noise.resize(values.size() * format.getValueSize());
+    PiPoFormatConverter::convertValues(&values[0], PiPoStreamFormat::Float32, &noise[0], format.valueType, values.size());
+    input = reinterpret_cast<const PiPoValue *>(&noise[0]);
+  }
+
+  // candidate tile sizes: none, and powers of two below the input block size
+  std::vector<unsigned int> candidates(1, 0);
+
+  for (unsigned int tile = 16; tile < maxFrames; tile *= 2)
+  {
+    candidates.push_back(tile);
+  }
+
+  unsigned int best = 0;
+  double bestTime = -1;
+
+  this->calibrating = true;
+
+  for (unsigned int c = 0; c < candidates.size(); ++c)
+  {
+    this->tuning[key] = candidates[c];
+
+    if (this->propagateInputStreamAttributes() < 0)
+    {
+      continue;
+    }
+
+    for (unsigned int r = 0; r < repetitions; ++r)
+    {
+      this->graph->reset();
+
+      std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+      for (unsigned int i = 0; i < numFrames; i += maxFrames)
+      {
+        this->frames(i * period, 1.0, static_cast<const void *>(reinterpret_cast<const char *>(input) + i * frameBytes),
+                     frameSize, std::min(maxFrames, numFrames - i));
+      }
+
+      double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+      if (bestTime < 0 || elapsed < bestTime)
+      {
+        bestTime = elapsed;
+        best = candidates[c];
+      }
+    }
+  }
+
+  this->calibrating = false;
+  this->tuning[key] = best;
   this->propagateInputStreamAttributes();
+  this->graph->reset();
+
+  return best;
+}
+
+bool
+PiPoHost::loadProfile(const std::string &path)
+{
+  std::ifstream file(path.c_str());
+  std::string line;
+
+  if (!file.is_open())
+  {
+    return false;
+  }
+
+  // one line per graph and input stream: key, tab, tile size
+  while (std::getline(file, line))
+  {
+    size_t tab = line.rfind('\t');
+
+    if (tab != std::string::npos)
+    {
+      this->tuning[line.substr(0, tab)] = (unsigned int) std::strtoul(line.c_str() + tab + 1, NULL, 10);
+    }
+  }
+
+  return true;
 }
 
-void
-PiPoHost::signalError(PiPo *pipo, std::string errorMsg)
-{
-  std::cout << "Error : " << errorMsg << std::endl;
+bool
+PiPoHost::saveProfile(const std::string &path)
+{
+  std::ofstream file(path.c_str());
+
+  if (!file.is_open())
+  {
+    return false;
+  }
+
+  for (std::map<std::string, unsigned int>::iterator it = this->tuning.begin(); it != this->tuning.end(); ++it)
+  {
+    file << it->first << '\t' << it->second << '\n';
+  }
+
+  return file.good();
+}
+
+std::string
+PiPoHost::getTuningKey()
+{
+  std::ostringstream key;
+
+  key << this->graphName << ' ' << this->inputStreamAttrs.dims[0] << 'x' << this->inputStreamAttrs.dims[1]
+      << ' ' << this->inputStreamAttrs.maxFrames << ' ' << this->inputStreamAttrs.rate
+      << ' ' << PiPoStreamFormat::getValueTypeName(this->inputStreamAttrs.format.valueType);
+
+  return key.str();
+}
+
+int
+PiPoHost::setOutputStreamFormat(const PiPoStreamFormat &format, bool propagate)
+{
+  this->outputFormat = format;
+
+  if (propagate)
+  {
+    int ret = this->propagateInputStreamAttributes();
+
+    this->drainDiagnostics();
+    return ret;
+  }
+
+  return 0;
+}
+
+void
+PiPoHost::setQueueAttrs(bool queue)
+{
+  this->queueAttrs = queue;
+}
+
+// set attribute values silently, returns false if they didn't change
+// (the values of a span are set at once, variable size attributes don't copy nor free memory)
+static bool
+applyAttrCommand(const PiPoAttrCommand &command)
+{
+  switch (command.kind)
+  {
+    case PiPoAttrCommand::SetInt:
+      return command.attr->applyValues(command.index, &command.value.i, 1);
+
+    case PiPoAttrCommand::SetDouble:
+      return command.attr->applyValues(command.index, &command.value.d, 1);
+
+    case PiPoAttrCommand::SetInts:
+      return command.attr->applyValues(command.index, command.value.ints, command.num);
+
+    case PiPoAttrCommand::SetDoubles:
+      return command.attr->applyValues(command.index, command.value.dbls, command.num);
+
+    case PiPoAttrCommand::SetString:
+    {
+      // the attribute points to the queued string even when equal, so that the control thread can free the previous one
+      bool change = command.attr->isChange(command.index, command.value.s);
+
+      command.attr->set(command.index, command.value.s, true);
+      return change;
+    }
+  }
+
+  return false;
+}
+
+// to be called by the thread running the graph, or when it is stopped
+int
+PiPoHost::applyQueuedAttrs()
+{
+  const PiPoAttrCommand *command;
+  PiPo *module = nullptr;
+  bool changed = false;
+
+  while ((command = this->attrQueue.front()) != nullptr)
+  {
+    if (command->scheduled)
+    {
+      // keep by time, in order of scheduling for equal times
+      if (this->scheduledAttrs.size() < this->scheduledAttrs.capacity())
+      {
+        std::vector<PiPoAttrCommand>::iterator it = this->scheduledAttrs.end();
+
+        while (it != this->scheduledAttrs.begin() && (it - 1)->time > command->time)
+        {
+          --it;
+        }
+
+        this->scheduledAttrs.insert(it, *command);
+        this->scheduledPending.store(this->scheduledAttrs.size());
+      }
+      else
+      {
+        this->postDiagnostic(nullptr, PiPoDiagnostic(PiPoDiagnostic::Overflow, PiPoDiagnostic::Error, nullptr,
+                                                     "too many scheduled attribute changes, change dropped"));
+      }
+    }
+    else if (applyAttrCommand(*command))
+    {
+      module = (!changed || module == command->attr->getPiPo()) ? command->attr->getPiPo() : nullptr;
+      changed = true;
+    }
+
+    // the control thread may free the command's values from now on
+    this->attrQueue.pop();
+  }
+
+  // all changes in one reconfiguration
+  if (changed)
+  {
+    return this->reconfigure(module);
+  }
+
+  return 0;
+}
+
+// stream attributes when queueing, and the attributes the processing thread may still change or read in place
+bool
+PiPoHost::isQueuedAttr(PiPo::Attr *attr)
+{
+  this->releaseAttrValues();
+
+  return (this->queueAttrs && attr->doesChangeStream()) || this->inPlaceAttrs.count(attr) > 0;
+}
+
+// push the commands of one attribute change as a group, applied at the same block boundary
+bool
+PiPoHost::queueAttr(const PiPoAttrCommand *commands, unsigned int num)
+{
+  this->releaseAttrValues();
+
+  // the changes of a transaction are one group, dropped as a whole
+  if (this->attrTransactionFailed)
+  {
+    return false;
+  }
+
+  for (unsigned int i = 0; i < num; ++i)
+  {
+    size_t position = this->attrQueue.pushed();
+
+    if (!this->attrQueue.push(commands[i]))
+    {
+      this->attrQueue.abort();
+
+      // values of the dropped commands
+      while (!this->attrValues.empty() && this->attrValues.back().position >= this->attrQueue.pushed())
+      {
+        this->attrValues.pop_back();
+      }
+
+      // attributes set in place last by dropped commands are published after the last command kept
+      for (auto it = this->inPlaceAttrs.begin(); it != this->inPlaceAttrs.end(); )
+      {
+        if (it->second.position < this->attrQueue.pushed())
+        {
+          ++it;
+        }
+        else if (this->attrQueue.pushed() > 0)
+        {
+          it->second.position = this->attrQueue.pushed() - 1;
+          ++it;
+        }
+        else
+        {
+          it = this->inPlaceAttrs.erase(it);
+        }
+      }
+
+      this->attrTransactionFailed = this->attrTransactionDepth > 0;
+      this->postDiagnostic(nullptr, PiPoDiagnostic(PiPoDiagnostic::Overflow, PiPoDiagnostic::Error, nullptr,
+                                                   "attribute queue full, change dropped"));
+      return false;
+    }
+
+    if (commands[i].attr->getIsVarSize() && commands[i].kind != PiPoAttrCommand::SetString)
+    {
+      PiPoInPlaceAttr &inPlace = this->inPlaceAttrs[commands[i].attr];
+
+      inPlace.position = position;
+      inPlace.scheduled = inPlace.scheduled || commands[i].scheduled;
+    }
+  }
+
+  if (this->attrTransactionDepth == 0)
+  {
+    this->attrQueue.commit();
+  }
+
+  return true;
+}
+
+void
+PiPoHost::beginAttrTransaction()
+{
+  this->attrTransactionDepth++;
+}
+
+bool
+PiPoHost::commitAttrTransaction()
+{
+  if (this->attrTransactionDepth == 0 || --this->attrTransactionDepth > 0)
+  {
+    return !this->attrTransactionFailed;
+  }
+
+  bool ok = !this->attrTransactionFailed;
+  bool changed = this->attrTransactionChanged;
+  PiPo *module = this->attrTransactionModule;
+
+  this->attrTransactionChanged = false;
+  this->attrTransactionModule = nullptr;
+  this->attrTransactionFailed = false;
+
+  if (ok)
+  {
+    this->attrQueue.commit();
+  }
+
+  if (changed && this->reconfigure(module) < 0)
+  {
+    this->drainDiagnostics();
+    return false;
+  }
+
+  this->drainDiagnostics();
+  return ok;
+}
+
+// when the graph is not running
+void
+PiPoHost::discardQueuedAttrs()
+{
+  while (this->attrQueue.front() != nullptr)
+  {
+    this->attrQueue.pop();
+  }
+
+  this->attrValues.clear();
+  this->attrStrings.clear();
+  this->inPlaceAttrs.clear();
+  this->scheduledAttrs.clear(); // of the modules deleted
+  this->scheduledPending.store(0);
+}
+
+// storage for the values of the next queued command (control thread)
+PiPoAttrValues &
+PiPoHost::keepAttrValues(PiPo::Attr *attr, unsigned int index)
+{
+  this->releaseAttrValues();
+  this->attrValues.push_back(PiPoAttrValues());
+
+  PiPoAttrValues &values = this->attrValues.back();
+
+  values.position = this->attrQueue.pushed();
+  values.attr = attr;
+  values.index = index;
+
+  return values;
+}
+
+// free the values of the commands applied by the processing thread, and publish the attributes
+// it doesn't change in place anymore, so that the control thread can change them again (control thread)
+void
+PiPoHost::releaseAttrValues()
+{
+  size_t consumed = this->attrQueue.consumed();
+  size_t scheduled = this->scheduledPending.load(); // commands consumed were scheduled before
+
+  for (auto it = this->inPlaceAttrs.begin(); it != this->inPlaceAttrs.end(); )
+  {
+    if (it->second.position < consumed && (!it->second.scheduled || scheduled == 0) && it->first->republish())
+    {
+      it = this->inPlaceAttrs.erase(it);
+    }
+    else
+    {
+      ++it;
+    }
+  }
+
+  while (!this->attrValues.empty() && this->attrValues.front().position < consumed)
+  {
+    PiPoAttrValues &values = this->attrValues.front();
+
+    // the attribute points to the string applied last, replacing the previous one
+    if (values.str != nullptr)
+    {
+      this->attrStrings[std::make_pair(values.attr, values.index)] = std::move(values.str);
+    }
+
+    this->attrValues.pop_front();
+  }
+}
+
+// apply the scheduled changes due at time, reconfigure once if stream attributes changed
+int
+PiPoHost::applyDueAttrs(double time, double tolerance)
+{
+  PiPo *module = nullptr;
+  bool changed = false;
+  unsigned int num = 0;
+
+  while (num < this->scheduledAttrs.size() && this->scheduledAttrs[num].time <= time + tolerance)
+  {
+    const PiPoAttrCommand &command = this->scheduledAttrs[num];
+
+    if (applyAttrCommand(command) && command.attr->doesChangeStream())
+    {
+      module = (!changed || module == command.attr->getPiPo()) ? command.attr->getPiPo() : nullptr;
+      changed = true;
+    }
+
+    num++;
+  }
+
+  if (num > 0)
+  {
+    this->scheduledAttrs.erase(this->scheduledAttrs.begin(), this->scheduledAttrs.begin() + num);
+    this->scheduledPending.store(this->scheduledAttrs.size());
+  }
+
+  if (changed)
+  {
+    return this->reconfigure(module);
+  }
+
+  return 0;
+}
+
+// process a block in parts, each starting at a frame where scheduled changes apply
+// (sampled frames with the given period, or time-tagged frames, blocks that can't be split are processed whole)
+template <typename PROCESS>
+int
+PiPoHost::splitAtScheduledAttrs(double time, double period, const double *times, unsigned int num, bool split,
+                                PROCESS process)
+{
+  double tolerance = 1e-6 * period;
+  unsigned int start = 0;
+
+  while (start < num)
+  {
+    double startTime = (times != nullptr) ? times[start] : time + start * period;
+    unsigned int end = num;
+    int ret = this->applyDueAttrs(startTime, tolerance);
+
+    if (ret < 0)
+    {
+      return ret;
+    }
+
+    if (split && !this->scheduledAttrs.empty())
+    {
+      double next = this->scheduledAttrs.front().time;
+
+      if (times != nullptr)
+      {
+        end = start + 1;
+
+        while (end < num && times[end] < next)
+        {
+          end++;
+        }
+      }
+      else if (period > 0)
+      {
+        double frame = std::ceil((next - time - tolerance) / period);
+
+        end = (frame >= num) ? num : std::max(start + 1, static_cast<unsigned int>(frame));
+      }
+    }
+
+    ret = process(start, end - start);
+
+    if (ret < 0)
+    {
+      return ret;
+    }
+
+    start = end;
+  }
+
+  return 0;
 }
 
-void
-PiPoHost::signalWarning(PiPo *pipo, std::string errorMsg)
+// binds the host's scratch arena to the calling thread while the graph runs, restoring the previous one after
+class PiPoScratchBinding
 {
-  std::cout << "Warning : " << errorMsg << std::endl;
-}
+  PiPoScratchArena *previous;
 
-// own methods
-bool
-PiPoHost::setGraph(std::string name)
+public:
+  PiPoScratchBinding(PiPoScratchArena *arena) : previous(PiPoScratchArena::current())
+  {
+    PiPoScratchArena::bind(arena);
+  }
+
+  ~PiPoScratchBinding()
+  {
+    PiPoScratchArena::bind(this->previous);
+  }
+};
+
+// pass block in the graph's input format on to the graph
+int
+PiPoHost::graphFrames(double time, double weight, PiPoValue *values, unsigned int size, unsigned int num)
 {
-  if (this->graph != nullptr)
+  PiPoScratchBinding binding(&this->scratchArena);
+
+  if (this->scheduledAttrs.empty())
   {
-    delete this->graph;
+    return this->graph->frames(time, weight, values, size, num);
   }
 
-  this->graph = PiPoCollection::create(name, static_cast<PiPo::Parent *>(this));
+  const PiPoStreamFormat &format = this->graph->getInputFormat();
+  size_t stride = (format.frameStride > 0 ? format.frameStride : size) * format.getValueSize();
+  double period = (!this->inputStreamAttrs.hasTimeTags && this->inputStreamAttrs.rate > 0) ? 1000.0 / this->inputStreamAttrs.rate : 0;
+  char *bytes = reinterpret_cast<char *>(values);
 
-  if (this->graph != nullptr)
+  return this->splitAtScheduledAttrs(time, period, nullptr, num, format.layout != PiPoStreamFormat::Planar,
+    [&](unsigned int start, unsigned int count)
+    {
+      return this->graph->frames(time + start * period, weight, reinterpret_cast<PiPoValue *>(bytes + start * stride), size, count);
+    });
+}
+
+int
+PiPoHost::graphFramesTimeTagged(const double *times, double weight, PiPoValue *values, unsigned int size, unsigned int num)
+{
+  PiPoScratchBinding binding(&this->scratchArena);
+
+  if (this->scheduledAttrs.empty())
   {
-    this->graphName = name;
-    this->graph->setReceiver((PiPo *)this->out);
-    return true;
+    return this->graph->framesTimeTagged(times, weight, values, size, num);
   }
 
-  this->graph = nullptr;
-  this->graphName = "undefined";
-  return false;
+  const PiPoStreamFormat &format = this->graph->getInputFormat();
+  size_t stride = (format.frameStride > 0 ? format.frameStride : size) * format.getValueSize();
+  char *bytes = reinterpret_cast<char *>(values);
+
+  return this->splitAtScheduledAttrs(0, 0, times, num, format.layout != PiPoStreamFormat::Planar,
+    [&](unsigned int start, unsigned int count)
+    {
+      return this->graph->framesTimeTagged(times + start, weight, reinterpret_cast<PiPoValue *>(bytes + start * stride), size, count);
+    });
 }
 
-void
-PiPoHost::clearGraph()
+int
+PiPoHost::graphFramesVarSize(const double *times, double weight, PiPoValue *values, const unsigned int *sizes, unsigned int num)
 {
-  if (this->graph != nullptr)
+  PiPoScratchBinding binding(&this->scratchArena);
+
+  if (this->scheduledAttrs.empty())
   {
-    delete this->graph;
-    this->graph = nullptr;
+    return this->graph->framesVarSize(times, weight, values, sizes, num);
   }
+
+  const PiPoStreamFormat &format = this->graph->getInputFormat();
+  unsigned int frameSize = this->inputStreamAttrs.dims[0] * this->inputStreamAttrs.dims[1];
+  size_t stride = (format.frameStride > 0 ? format.frameStride : frameSize) * format.getValueSize();
+  char *bytes = reinterpret_cast<char *>(values);
+
+  return this->splitAtScheduledAttrs(0, 0, times, num, format.layout != PiPoStreamFormat::Planar,
+    [&](unsigned int start, unsigned int count)
+    {
+      return this->graph->framesVarSize(times + start, weight, reinterpret_cast<PiPoValue *>(bytes + start * stride), sizes + start, count);
+    });
 }
 
-// override this method when inheriting !!!
-// void
-// PiPoHost::onNewFrame(std::function<void (double, double, PiPoValue *, unsigned int)> f)
-// {
-//   this->frameCallback = f;
-// }
+static PiPoAttrCommand
+attrCommand(PiPo::Attr *attr, PiPoAttrCommand::Kind kind, unsigned int index)
+{
+  PiPoAttrCommand command;
 
-// override this method when inheriting !!!
-void
-PiPoHost::onNewFrame(double time, double weight, PiPoValue *values, unsigned int size)
+  command.attr = attr;
+  command.kind = kind;
+  command.index = index;
+  command.num = 1;
+  command.scheduled = false;
+  command.time = 0;
+  command.value.d = 0;
+
+  return command;
+}
+
+static PiPoAttrCommand
+attrCommand(PiPo::Attr *attr, unsigned int index, int value)
 {
-  std::cout << time << std::endl;
-  std::cout << "please override this method" << std::endl;
+  PiPoAttrCommand command = attrCommand(attr, PiPoAttrCommand::SetInt, index);
+
+  command.value.i = value;
+  return command;
 }
 
-std::vector<PiPoValue>
-PiPoHost::getLastFrame()
+static PiPoAttrCommand
+attrCommand(PiPo::Attr *attr, unsigned int index, double value)
 {
-  return this->out->getLastFrame();
+  PiPoAttrCommand command = attrCommand(attr, PiPoAttrCommand::SetDouble, index);
+
+  command.value.d = value;
+  return command;
 }
 
-int
-PiPoHost::setInputStreamAttributes(const PiPoStreamAttributes &sa, bool propagate)
+static PiPoAttrCommand
+attrCommand(PiPo::Attr *attr, unsigned int index, const char *value)
 {
-  this->inputStreamAttrs = sa;
+  PiPoAttrCommand command = attrCommand(attr, PiPoAttrCommand::SetString, index);
 
-  if (propagate)
-  {
-    return this->propagateInputStreamAttributes();
-  }
+  command.value.s = value;
+  return command;
+}
 
-  return 0;
+static PiPoAttrCommand
+attrCommand(PiPo::Attr *attr, unsigned int index, const int *values, unsigned int num)
+{
+  PiPoAttrCommand command = attrCommand(attr, PiPoAttrCommand::SetInts, index);
+
+  command.num = num;
+  command.value.ints = values;
+  return command;
 }
 
-PiPoStreamAttributes&
-PiPoHost::getOutputStreamAttributes()
+static PiPoAttrCommand
+attrCommand(PiPo::Attr *attr, unsigned int index, const double *values, unsigned int num)
 {
-  return this->outputStreamAttrs;
+  PiPoAttrCommand command = attrCommand(attr, PiPoAttrCommand::SetDoubles, index);
+
+  command.num = num;
+  command.value.dbls = values;
+  return command;
 }
 
-int
-PiPoHost::frames(double time, double weight, PiPoValue *values, unsigned int size,
-                 unsigned int num)
+// hashed index of the graph's attributes, so that setting attributes by name doesn't scan them
+void
+PiPoHost::indexAttrs()
+{
+  this->attrIndex.clear();
+
+  if (this->graph != nullptr)
+  {
+    unsigned int num = this->graph->getNumAttrs();
+
+    this->attrIndex.reserve(num);
+
+    for (unsigned int i = 0; i < num; ++i)
+    {
+      PiPo::Attr *attr = this->graph->getAttr(i);
+
+      this->attrIndex.emplace(attr->getName(), attr); // first of equal names, as PiPo::getAttr
+    }
+  }
+}
+
+PiPo::Attr *
+PiPoHost::getAttrHandle(const std::string &attrName)
 {
-  return this->graph->frames(time, weight, values, size, num);
+  auto it = this->attrIndex.find(attrName);
+
+  return it != this->attrIndex.end() ? it->second : nullptr;
 }
 
 std::vector<std::string>
@@ -180,21 +1179,13 @@ PiPoHost::getAttrNames()
 bool
 PiPoHost::setAttr(const std::string &attrName, bool value)
 {
-  PiPo::Attr *attr = this->graph->getAttr(attrName.c_str());
-
-  if (attr != NULL)
-  {
-    int iAttr = attr->getIndex();
-    return this->graph->setAttr(iAttr, value ? 1 : 0);
-  }
-
-  return false;
+  return this->setAttr(this->getAttrHandle(attrName), value);
 }
 
 bool
 PiPoHost::setAttr(const std::string &attrName, const std::string &value) // for enums
 {
-  PiPo::Attr *attr = this->graph->getAttr(attrName.c_str());
+  PiPo::Attr *attr = this->getAttrHandle(attrName);
 
   if (attr != NULL)
   {
@@ -208,14 +1199,40 @@ PiPoHost::setAttr(const std::string &attrName, const std::string &value) // for
       {
         if (strcmp(list->at(i), value.c_str()) == 0)
         {
-          attr->set(0, i);
+          if (this->isQueuedAttr(attr))
+          {
+            PiPoAttrCommand command = attrCommand(attr, 0, i);
+            return this->queueAttr(&command, 1);
+          }
+
+          if (attr->isChange(0, i))
+          {
+            attr->set(0, i);
+          }
+
           return true;
         }
       }
     }
     else if (type == PiPo::Type::String)
     {
-      attr->set(0, value.c_str());
+      if (this->isQueuedAttr(attr))
+      {
+        // the string must outlive the queued command
+        PiPoAttrValues &kept = this->keepAttrValues(attr, 0);
+
+        kept.str.reset(new std::string(value));
+
+        PiPoAttrCommand command = attrCommand(attr, 0, kept.str->c_str());
+        return this->queueAttr(&command, 1);
+      }
+
+      if (attr->isChange(0, value.c_str()))
+      {
+        attr->set(0, value.c_str());
+      }
+
+      return true;
     }
   }
 
@@ -225,72 +1242,140 @@ PiPoHost::setAttr(const std::string &attrName, const std::string &value) // for
 bool
 PiPoHost::setAttr(const std::string &attrName, int value)
 {
-  PiPo::Attr *attr = this->graph->getAttr(attrName.c_str());
+  return this->setAttr(this->getAttrHandle(attrName), value);
+}
+
+bool
+PiPoHost::setAttr(const std::string &attrName, double value)
+{
+  return this->setAttr(this->getAttrHandle(attrName), value);
+}
 
-  if (attr != NULL)
+bool
+PiPoHost::setAttr(const std::string &attrName, const std::vector<int> &values)
+{
+  return this->setAttr(this->getAttrHandle(attrName), values.data(), static_cast<unsigned int>(values.size()));
+}
+
+bool
+PiPoHost::setAttr(const std::string &attrName, const std::vector<double> &values)
+{
+  return this->setAttr(this->getAttrHandle(attrName), values.data(), static_cast<unsigned int>(values.size()));
+}
+
+bool
+PiPoHost::setAttr(PiPo::Attr *attr, bool value)
+{
+  return this->setAttr(attr, value ? 1 : 0);
+}
+
+bool
+PiPoHost::setAttr(PiPo::Attr *attr, int value)
+{
+  if (attr != nullptr)
   {
-    int iAttr = attr->getIndex();
-    return this->graph->setAttr(iAttr, value);
+    if (this->isQueuedAttr(attr))
+    {
+      PiPoAttrCommand command = attrCommand(attr, 0, value);
+      return this->queueAttr(&command, 1);
+    }
+
+    return this->graph->setAttr(attr->getIndex(), value);
   }
 
   return false;
 }
 
 bool
-PiPoHost::setAttr(const std::string &attrName, double value)
+PiPoHost::setAttr(PiPo::Attr *attr, double value)
 {
-  PiPo::Attr *attr = this->graph->getAttr(attrName.c_str());
-
-  if (attr != NULL)
+  if (attr != nullptr)
   {
-    int iAttr = attr->getIndex();
-    return this->graph->setAttr(iAttr, value);
+    if (this->isQueuedAttr(attr))
+    {
+      PiPoAttrCommand command = attrCommand(attr, 0, value);
+      return this->queueAttr(&command, 1);
+    }
+
+    return this->graph->setAttr(attr->getIndex(), value);
   }
 
   return false;
 }
 
 bool
-PiPoHost::setAttr(const std::string &attrName, const std::vector<int> &values)
+PiPoHost::setAttr(PiPo::Attr *attr, const int *values, unsigned int num)
 {
-  PiPo::Attr *attr = this->graph->getAttr(attrName.c_str());
-
-  if (attr != NULL)
+  if (attr != nullptr)
   {
-    PiPo::Type type = attr->getType();
+    if (this->isQueuedAttr(attr))
+    {
+      // one command for all values, set at once by the processing thread
+      PiPoAttrValues &kept = this->keepAttrValues(attr, 0);
 
-    int iAttr = attr->getIndex();
-    int vals[values.size()];
+      kept.ints.assign(values, values + num);
 
-    for (unsigned int i = 0; i < values.size(); ++i)
+      PiPoAttrCommand command = attrCommand(attr, 0, kept.ints.data(), num);
+      return this->queueAttr(&command, 1);
+    }
+
+    return this->graph->setAttr(attr->getIndex(), values, num);
+  }
+
+  return false;
+}
+
+bool
+PiPoHost::setAttr(PiPo::Attr *attr, const double *values, unsigned int num)
+{
+  if (attr != nullptr)
+  {
+    if (this->isQueuedAttr(attr))
     {
-      vals[i] = values[i];
+      // one command for all values, set at once by the processing thread
+      PiPoAttrValues &kept = this->keepAttrValues(attr, 0);
+
+      kept.dbls.assign(values, values + num);
+
+      PiPoAttrCommand command = attrCommand(attr, 0, kept.dbls.data(), num);
+      return this->queueAttr(&command, 1);
     }
 
-    return this->graph->setAttr(iAttr, &vals[0], static_cast<unsigned int>(values.size()));
+    return this->graph->setAttr(attr->getIndex(), values, num);
   }
 
   return false;
 }
 
 bool
-PiPoHost::setAttr(const std::string &attrName, const std::vector<double> &values)
+PiPoHost::scheduleAttr(double time, const std::string &attrName, int value)
 {
-  PiPo::Attr *attr = this->graph->getAttr(attrName.c_str());
+  PiPo::Attr *attr = this->getAttrHandle(attrName);
 
   if (attr != NULL)
   {
-    PiPo::Type type = attr->getType();
+    PiPoAttrCommand command = attrCommand(attr, 0, value);
 
-    int iAttr = attr->getIndex();
-    double vals[values.size()];
+    command.scheduled = true;
+    command.time = time;
+    return this->queueAttr(&command, 1);
+  }
 
-    for (unsigned int i = 0; i < values.size(); ++i)
-    {
-      vals[i] = values[i];
-    }
+  return false;
+}
+
+bool
+PiPoHost::scheduleAttr(double time, const std::string &attrName, double value)
+{
+  PiPo::Attr *attr = this->getAttrHandle(attrName);
 
-    return this->graph->setAttr(iAttr, &vals[0], static_cast<unsigned int>(values.size()));
+  if (attr != NULL)
+  {
+    PiPoAttrCommand command = attrCommand(attr, 0, value);
+
+    command.scheduled = true;
+    command.time = time;
+    return this->queueAttr(&command, 1);
   }
 
   return false;
@@ -301,7 +1386,7 @@ PiPoHost::setAttr(const std::string &attrName, const std::vector<double> &values
 bool
 PiPoHost::isBoolAttr(const std::string &attrName)
 {
-  PiPo::Attr *attr = this->graph->getAttr(attrName.c_str());
+  PiPo::Attr *attr = this->getAttrHandle(attrName);
 
   if (attr != NULL)
   {
@@ -314,7 +1399,7 @@ PiPoHost::isBoolAttr(const std::string &attrName)
 bool
 PiPoHost::isEnumAttr(const std::string &attrName)
 {
-  PiPo::Attr *attr = this->graph->getAttr(attrName.c_str());
+  PiPo::Attr *attr = this->getAttrHandle(attrName);
 
   if (attr != NULL)
   {
@@ -327,7 +1412,7 @@ PiPoHost::isEnumAttr(const std::string &attrName)
 std::vector<std::string>
 PiPoHost::getAttrEnumList(const std::string &attrName)
 {
-  PiPo::Attr *attr = this->graph->getAttr(attrName.c_str());
+  PiPo::Attr *attr = this->getAttrHandle(attrName);
 
   if (attr != NULL)
   {
@@ -359,7 +1444,7 @@ PiPoHost::getAttrEnumList(const std::string &attrName)
 bool
 PiPoHost::isStringAttr(const std::string &attrName)
 {
-  PiPo::Attr *attr = this->graph->getAttr(attrName.c_str());
+  PiPo::Attr *attr = this->getAttrHandle(attrName);
 
   if (attr != NULL)
   {
@@ -372,7 +1457,7 @@ PiPoHost::isStringAttr(const std::string &attrName)
 bool
 PiPoHost::isIntAttr(const std::string &attrName)
 {
-  PiPo::Attr *attr = this->graph->getAttr(attrName.c_str());
+  PiPo::Attr *attr = this->getAttrHandle(attrName);
 
   if (attr != NULL)
   {
@@ -385,7 +1470,7 @@ PiPoHost::isIntAttr(const std::string &attrName)
 bool
 PiPoHost::isDoubleAttr(const std::string &attrName)
 {
-  PiPo::Attr *attr = this->graph->getAttr(attrName.c_str());
+  PiPo::Attr *attr = this->getAttrHandle(attrName);
 
   if (attr != NULL)
   {
@@ -400,7 +1485,7 @@ PiPoHost::isDoubleAttr(const std::string &attrName)
 bool
 PiPoHost::getBoolAttr(const std::string &attrName)
 {
-  PiPo::Attr *attr = this->graph->getAttr(attrName.c_str());
+  PiPo::Attr *attr = this->getAttrHandle(attrName);
 
   if (attr != NULL)
   {
@@ -418,7 +1503,7 @@ PiPoHost::getBoolAttr(const std::string &attrName)
 std::string
 PiPoHost::getEnumAttr(const std::string &attrName)
 {
-  PiPo::Attr *attr = this->graph->getAttr(attrName.c_str());
+  PiPo::Attr *attr = this->getAttrHandle(attrName);
 
   if (attr != NULL)
   {
@@ -436,7 +1521,7 @@ PiPoHost::getEnumAttr(const std::string &attrName)
 std::string
 PiPoHost::getStringAttr(const std::string &attrName)
 {
-  PiPo::Attr *attr = this->graph->getAttr(attrName.c_str());
+  PiPo::Attr *attr = this->getAttrHandle(attrName);
 
   if (attr != NULL)
   {
@@ -454,7 +1539,7 @@ PiPoHost::getStringAttr(const std::string &attrName)
 int
 PiPoHost::getIntAttr(const std::string &attrName)
 {
-  PiPo::Attr *attr = this->graph->getAttr(attrName.c_str());
+  PiPo::Attr *attr = this->getAttrHandle(attrName);
 
   if (attr != NULL)
   {
@@ -472,7 +1557,7 @@ PiPoHost::getIntAttr(const std::string &attrName)
 double
 PiPoHost::getDoubleAttr(const std::string &attrName)
 {
-  PiPo::Attr *attr = this->graph->getAttr(attrName.c_str());
+  PiPo::Attr *attr = this->getAttrHandle(attrName);
 
   if (attr != NULL)
   {
@@ -491,7 +1576,7 @@ std::vector<int>
 PiPoHost::getIntArrayAttr(const std::string &attrName)
 {
   std::vector<int> res;
-  PiPo::Attr *attr = this->graph->getAttr(attrName.c_str());
+  PiPo::Attr *attr = this->getAttrHandle(attrName);
 
   if (attr != NULL) {
     PiPo::Type type = attr->getType();
@@ -513,7 +1598,7 @@ std::vector<double>
 PiPoHost::getDoubleArrayAttr(const std::string &attrName)
 {
   std::vector<double> res;
-  PiPo::Attr *attr = this->graph->getAttr(attrName.c_str());
+  PiPo::Attr *attr = this->getAttrHandle(attrName);
 
   if (attr != NULL) {
     PiPo::Type type = attr->getType();
@@ -531,26 +1616,112 @@ PiPoHost::getDoubleArrayAttr(const std::string &attrName)
   return res;
 }
 
+const int *
+PiPoHost::getIntArrayAttr(PiPo::Attr *attr, unsigned int &size)
+{
+  const int *values = (attr != nullptr) ? attr->getIntValues() : nullptr;
+
+  size = (values != nullptr) ? attr->getSize() : 0;
+  return values;
+}
+
+const double *
+PiPoHost::getDoubleArrayAttr(PiPo::Attr *attr, unsigned int &size)
+{
+  const double *values = (attr != nullptr) ? attr->getDblValues() : nullptr;
+
+  size = (values != nullptr) ? attr->getSize() : 0;
+  return values;
+}
+
 
 int
 PiPoHost::propagateInputStreamAttributes()
 {
   if (this->graph != nullptr)
   {
-    return this->graph->streamAttributes(this->inputStreamAttrs.hasTimeTags,
-                                         this->inputStreamAttrs.rate,
-                                         this->inputStreamAttrs.offset,
-                                         this->inputStreamAttrs.dims[0],
-                                         this->inputStreamAttrs.dims[1],
-                                         this->inputStreamAttrs.labels,
-                                         this->inputStreamAttrs.hasVarSize,
-                                         this->inputStreamAttrs.domain,
-                                         this->inputStreamAttrs.maxFrames);
+    // the graph chooses the format of its input, we convert if it differs
+    unsigned int width = this->inputStreamAttrs.dims[0];
+    unsigned int height = this->inputStreamAttrs.dims[1];
+    unsigned int maxFrames = this->inputStreamAttrs.maxFrames;
+    PiPoStreamFormat format = this->inputStreamAttrs.format;
+
+    // tile size found by autotune() or set for this graph and input stream
+    std::map<std::string, unsigned int>::iterator tuned = this->tuning.find(this->getTuningKey());
+
+    if (tuned != this->tuning.end())
+    {
+      this->tileSize = tuned->second;
+    }
+
+    setGraphTileSize(this->graph, this->tileSize);
+
+    format.resolve(width, height);
+    this->graph->negotiateInputFormat(format);
+    this->inputConverter.setup(this->inputStreamAttrs.format, format, width, height, maxFrames);
+    this->planarConverter.setup(PiPoStreamFormat(PiPoStreamFormat::Float32, PiPoStreamFormat::Planar),
+                                format, width, height, maxFrames);
+
+    if (this->inputConverter.isActive())
+    {
+      this->graph->setInputFormat(this->inputConverter.getOutputFormat());
+    }
+    else
+    {
+      this->graph->setInputFormat(this->inputConverter.getInputFormat());
+    }
+
+    // planar block or interleaved frames with the graph's padding
+    this->planarBuffer.resize(std::max(width * height, this->planarConverter.getOutputFormat().frameStride) *
+                              maxFrames * sizeof(PiPoValue));
+
+    int ret = this->graph->receiveStreamAttributes(this->inputStreamAttrs.hasTimeTags,
+                                                   this->inputStreamAttrs.rate,
+                                                   this->inputStreamAttrs.offset,
+                                                   this->inputStreamAttrs.dims[0],
+                                                   this->inputStreamAttrs.dims[1],
+                                                   this->inputStreamAttrs.labels,
+                                                   this->inputStreamAttrs.hasVarSize,
+                                                   this->inputStreamAttrs.domain,
+                                                   this->inputStreamAttrs.maxFrames);
+
+    this->reserveScratch();
+    return ret;
   }
 
   return 0;
 }
 
+// reconfigure the graph after stream attributes of pipo changed (nullptr for several modules), from pipo on
+// when the graph can restart there, otherwise from the input
+int
+PiPoHost::reconfigure(PiPo *pipo)
+{
+  PiPoGraph *pipoGraph = dynamic_cast<PiPoGraph *>(this->graph);
+
+  if (pipo != nullptr && pipoGraph != nullptr && pipoGraph->canRestartStreamAttributes(pipo))
+  {
+    int ret = pipoGraph->restartStreamAttributes(pipo);
+
+    this->reserveScratch();
+    return ret;
+  }
+
+  return this->propagateInputStreamAttributes();
+}
+
+// grow the scratch arena to the largest scratch size planned for the graphs of the host
+void
+PiPoHost::reserveScratch()
+{
+  PiPoGraph *pipoGraph = dynamic_cast<PiPoGraph *>(this->graph);
+
+  if (pipoGraph != nullptr)
+  {
+    this->scratchArena.reserve(pipoGraph->getMemoryPlanner().getScratchSize());
+  }
+}
+
 void
 PiPoHost::setOutputStreamAttributes(bool hasTimeTags, double rate, double offset,
                                     unsigned int width, unsigned int height,
@@ -605,6 +1776,7 @@ PiPoOut::PiPo((PiPo::Parent *)host)
   writeIndex = 0;
   readIndex = 0;
   ringBuffer.resize(PIPO_OUT_RING_SIZE);
+  period = 0;
 }
 
 PiPoOut::~PiPoOut() {}
@@ -618,12 +1790,16 @@ PiPoOut::streamAttributes(bool hasTimeTags,
 {
   this->host->setOutputStreamAttributes(hasTimeTags, rate, offset, width, height,
                                         labels, hasVarSize, domain, maxFrames);
+  this->host->outputStreamAttrs.format = this->getInputFormat();
 
   for (int i = 0; i < PIPO_OUT_RING_SIZE; ++i)
   {
     ringBuffer[i].resize(width * height);
   }
 
+  this->period = (!hasTimeTags && rate > 0) ? 1000.0 / rate : 0;
+  this->frame.resize(width * height);
+
   return 0;
 }
 
@@ -631,11 +1807,35 @@ int
 PiPoOut::frames(double time, double weight, PiPoValue *values,
                 unsigned int size, unsigned int num)
 {
+  const PiPoStreamFormat &format = this->getInputFormat();
+  size_t valueSize = format.getValueSize();
+  size_t frameBytes = (format.frameStride > 0 ? format.frameStride : size) * valueSize;
+
+  if (this->host->calibrating)
+  {
+    return 0;
+  }
+
   if (num > 0)
   {
-    for (int i = 0; i < num; ++i)
+    for (unsigned int i = 0; i < num; ++i)
     {
-      this->host->onNewFrame(time, weight, values, size);
+      PiPoValue *frameValues = (PiPoValue *) ((char *) values + i * frameBytes);
+
+      if (format.layout == PiPoStreamFormat::Planar)
+      {
+        // gather the frame's element from each plane
+        char *dst = (char *) this->frame.data();
+
+        for (unsigned int j = 0; j < size && j < this->frame.size(); ++j)
+        {
+          std::memcpy(dst + j * valueSize, (char *) values + (j * num + i) * valueSize, valueSize);
+        }
+
+        frameValues = (PiPoValue *) dst;
+      }
+
+      this->host->onNewFrame(time + i * this->period, weight, frameValues, size);
       // this->host->frameCallback(time, weight, values, size);
 
       /*
@@ -667,6 +1867,33 @@ PiPoOut::frames(double time, double weight, PiPoValue *values,
   return 0;
 }
 
+int
+PiPoOut::framesVarSize(const double *times, double weight, PiPoValue *values,
+                       const unsigned int *sizes, unsigned int num)
+{
+  const PiPoStreamFormat &format = this->getInputFormat();
+  size_t frameBytes = format.frameStride * format.getValueSize();
+
+  if (this->host->calibrating)
+  {
+    return 0;
+  }
+
+  for (unsigned int i = 0; i < num; ++i)
+  {
+    this->host->onNewFrame(times[i], weight, (PiPoValue *) ((char *) values + i * frameBytes), sizes[i]);
+  }
+
+  return 0;
+}
+
+void
+PiPoOut::negotiateInputFormat(PiPoStreamFormat &format)
+{
+  // the last module converts to the format requested by the host
+  format = this->host->outputFormat;
+}
+
 std::vector<PiPoValue>
 PiPoOut::getLastFrame()
 {
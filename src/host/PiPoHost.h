@@ -43,12 +43,56 @@
 
 #define PIPO_OUT_RING_SIZE 2
 
+#include <atomic>
+#include <cctype>
+#include <deque>
 #include <iostream>
+#include <map>
+#include <memory>
+#include <unordered_map>
 
 #include "PiPo.h"
+#include "PiPoDiagnostics.h"
+#include "PiPoAttrQueue.h"
 
 class PiPoOut;
 
+// case-insensitive hashing and comparison of attribute names (as PiPo::getAttr)
+struct PiPoAttrNameHash {
+  size_t operator()(const std::string &name) const
+  {
+    size_t hash = 2166136261u; // FNV-1a
+
+    for (size_t i = 0; i < name.size(); ++i)
+      hash = (hash ^ static_cast<size_t>(std::tolower(static_cast<unsigned char>(name[i])))) * 16777619u;
+
+    return hash;
+  }
+};
+
+struct PiPoAttrNameEqual {
+  bool operator()(const std::string &a, const std::string &b) const
+  {
+    return a.size() == b.size() && strcasecmp(a.c_str(), b.c_str()) == 0;
+  }
+};
+
+// values of a queued attribute command, freed by the control thread once it is applied
+struct PiPoAttrValues {
+  size_t position;           // queue position of the command
+  PiPo::Attr *attr;
+  unsigned int index;
+  std::vector<int> ints;
+  std::vector<double> dbls;
+  std::unique_ptr<std::string> str; // kept while the attribute points to it
+};
+
+// variable size attribute changed in place by queued commands, published again once they are applied
+struct PiPoInPlaceAttr {
+  size_t position;           // queue position of the last command
+  bool scheduled;            // a command was scheduled (applied after leaving the queue)
+};
+
 //================================= PiPoHost =================================//
 
 // this class is meant to be a base class, child classes should override the
@@ -64,6 +108,29 @@ protected:
 
   PiPoStreamAttributes inputStreamAttrs;
   PiPoStreamAttributes outputStreamAttrs;
+  PiPoStreamFormat outputFormat;     // format requested for output frames
+  PiPoFormatConverter inputConverter; // converts input frames when the graph doesn't accept the input format
+  PiPoFormatConverter planarConverter; // converts separate float channels gathered into planarBuffer
+  PiPoAlignedBuffer planarBuffer;
+  PiPoScratchArena scratchArena;       // scratch memory of all modules, bound to the thread running the graph
+  bool skipUnchanged;                  // don't run the graph for blocks flagged unchanged
+  unsigned int tileSize;               // tiled execution of the graph, 0 for none
+  bool calibrating;                    // output frames are dropped during autotuning
+  std::map<std::string, unsigned int> tuning; // tile sizes found by autotune(), by graph and input stream
+  PiPoDiagnosticRing diagnostics;      // diagnostics posted by the graph, passed on by drainDiagnostics()
+  PiPoDiagnostic::Severity diagnosticLevel; // diagnostics of lower severity are ignored
+  bool queueAttrs;                     // stream attributes are set by the processing thread at block boundaries
+  PiPoAttrQueue attrQueue;             // changes of stream attributes waiting to be applied
+  std::deque<PiPoAttrValues> attrValues; // values of queued commands, kept valid until applied
+  std::map<std::pair<PiPo::Attr *, unsigned int>, std::unique_ptr<std::string>> attrStrings; // last queued strings applied, by attribute and index
+  std::map<PiPo::Attr *, PiPoInPlaceAttr> inPlaceAttrs; // variable size attributes set by queued commands
+  std::vector<PiPoAttrCommand> scheduledAttrs; // scheduled attribute changes by time (processing thread)
+  std::atomic<size_t> scheduledPending; // number of scheduledAttrs, for the control thread
+  unsigned int attrTransactionDepth;   // nesting of attribute transactions
+  bool attrTransactionChanged;         // a stream attribute was set in the transaction
+  PiPo *attrTransactionModule;         // module of the stream attributes set, nullptr if several
+  bool attrTransactionFailed;          // queued changes of the transaction were dropped
+  std::unordered_map<std::string, PiPo::Attr *, PiPoAttrNameHash, PiPoAttrNameEqual> attrIndex; // attributes of the graph by name
 
   // std::function<void (double, double, PiPoValue *, unsigned int)> frameCallback;
 
@@ -78,6 +145,18 @@ public:
   virtual void streamAttributesChanged(PiPo *pipo, PiPo::Attr *attr);
   virtual void signalError(PiPo *pipo, std::string errorMsg);
   virtual void signalWarning(PiPo *pipo, std::string errorMsg);
+  virtual void postDiagnostic(PiPo *pipo, const PiPoDiagnostic &diagnostic);
+
+  // pass queued diagnostics on to onDiagnostic (call from a non real-time thread), returns their number
+  // (the host also drains them when the graph or the stream attributes are set, and when attributes change
+  // the stream, a host running the graph on a real-time thread calls it regularly for the diagnostics of frames())
+  virtual unsigned int drainDiagnostics();
+
+  // override this method to output diagnostics (the default writes them to std::cerr)
+  virtual void onDiagnostic(const PiPoDiagnostic &diagnostic);
+
+  // ignore diagnostics of lower severity (default PiPoDiagnostic::Info)
+  virtual void setDiagnosticLevel(PiPoDiagnostic::Severity level);
 
   // override this method when inheriting !!!
   // virtual void onNewFrame(std::function<void (double, double, PiPoValue *, unsigned int)> f);
@@ -92,6 +171,63 @@ public:
   virtual int frames(double time, double weight, PiPoValue *values, unsigned int size,
                      unsigned int num);
 
+  // input values in the format given by the input stream attributes
+  virtual int frames(double time, double weight, const void *values, unsigned int size,
+                     unsigned int num);
+
+  // input of separate float channels (e.g. audio buffers), whatever the input stream format
+  virtual int frames(double time, double weight, PiPoValue **channels, unsigned int numChannels,
+                     unsigned int num);
+
+  // input of a block of frames with activity flags (see PiPo::ActivityFlags and PiPo::detectActivity())
+  virtual int frames(double time, double weight, PiPoValue *values, unsigned int size,
+                     unsigned int num, unsigned int activity);
+
+  // skip the graph for unchanged input blocks, so that the output of the last block holds
+  virtual void setSkipUnchanged(bool skip);
+
+  // input of a block of frames with a time-tag per frame (for time-tagged streams)
+  virtual int framesTimeTagged(const double *times, double weight, PiPoValue *values, unsigned int size,
+                               unsigned int num);
+
+  // input of a block of variable size frames with a size and a time-tag per frame (for varsize streams)
+  virtual int framesVarSize(const double *times, double weight, PiPoValue *values,
+                            const unsigned int *sizes, unsigned int num);
+
+  // tiled execution of input blocks through the graph (when it is a sequence), 0 for none
+  virtual bool setTileSize(unsigned int numFrames, bool propagate = true);
+  virtual unsigned int getTileSize();
+
+  // calibration: run the graph over numFrames input frames (noise if input is NULL) with candidate tile sizes,
+  // keep and return the fastest (the output is dropped, the graph is reset)
+  virtual unsigned int autotune(const PiPoValue *input = NULL, unsigned int numFrames = 0, unsigned int repetitions = 3);
+
+  // per-machine profile of tile sizes found by autotune(), applied when the graph and input stream match
+  virtual bool loadProfile(const std::string &path);
+  virtual bool saveProfile(const std::string &path);
+
+  // queue changes of stream attributes (setAttr) to be applied by the thread calling frames, at the next block,
+  // in one reconfiguration, other attributes are set directly without blocking
+  // (variable size attributes changed in place by queued or scheduled changes are queued until handed back)
+  virtual void setQueueAttrs(bool queue);
+
+  // apply queued attribute changes now (called at the start of each block), returns the result of the reconfiguration
+  virtual int applyQueuedAttrs();
+
+  // set any number of attributes until the matching commit, with a single reconfiguration by the commit
+  // (queued changes are applied together), transactions can be nested
+  virtual void beginAttrTransaction();
+  // returns false if queued changes were dropped or the reconfiguration failed
+  // (when the queue is full while the graph is stopped, call applyQueuedAttrs() to make room and set them again)
+  virtual bool commitAttrTransaction();
+
+  // change attribute at the input frame of the given time (ms), splitting the block it falls into
+  virtual bool scheduleAttr(double time, const std::string &attrName, int value);
+  virtual bool scheduleAttr(double time, const std::string &attrName, double value);
+
+  // format of the values passed to onNewFrame, converted from the graph's output if needed
+  virtual int setOutputStreamFormat(const PiPoStreamFormat &format, bool propagate = true);
+
   virtual std::vector<std::string> getAttrNames();
 
   virtual bool setAttr(const std::string &attrName, bool value);
@@ -101,6 +237,17 @@ public:
   virtual bool setAttr(const std::string &attrName, const std::vector<int> &values);
   virtual bool setAttr(const std::string &attrName, const std::vector<double> &values);
 
+  // attribute resolved once by name for the setters and getters below (e.g. per control message),
+  // valid until the graph is changed, nullptr if there is no such attribute
+  virtual PiPo::Attr *getAttrHandle(const std::string &attrName);
+
+  virtual bool setAttr(PiPo::Attr *attr, bool value);
+  virtual bool setAttr(PiPo::Attr *attr, int value);
+  virtual bool setAttr(PiPo::Attr *attr, double value);
+  // set num values from the first, with a single change notification
+  virtual bool setAttr(PiPo::Attr *attr, const int *values, unsigned int num);
+  virtual bool setAttr(PiPo::Attr *attr, const double *values, unsigned int num);
+
   virtual bool isBoolAttr(const std::string &attrName);
   virtual bool isEnumAttr(const std::string &attrName);
   virtual std::vector<std::string> getAttrEnumList(const std::string &attrName);
@@ -116,8 +263,29 @@ public:
   virtual std::vector<int> getIntArrayAttr(const std::string &attrName);
   virtual std::vector<double> getDoubleArrayAttr(const std::string &attrName);
 
+  // values of a vector attribute without copying, valid until it is set again,
+  // nullptr if they are not stored as int (double)
+  virtual const int *getIntArrayAttr(PiPo::Attr *attr, unsigned int &size);
+  virtual const double *getDoubleArrayAttr(PiPo::Attr *attr, unsigned int &size);
+
 private:
+  void indexAttrs();
   int propagateInputStreamAttributes();
+  int reconfigure(PiPo *pipo);
+  void reserveScratch();
+  bool isQueuedAttr(PiPo::Attr *attr);
+  bool queueAttr(const PiPoAttrCommand *commands, unsigned int num);
+  PiPoAttrValues &keepAttrValues(PiPo::Attr *attr, unsigned int index);
+  void releaseAttrValues();
+  void discardQueuedAttrs();
+  int inputFrames(double time, double weight, const void *values, unsigned int size, unsigned int num);
+  int applyDueAttrs(double time, double tolerance);
+  template <typename PROCESS>
+  int splitAtScheduledAttrs(double time, double period, const double *times, unsigned int num, bool split, PROCESS process);
+  int graphFrames(double time, double weight, PiPoValue *values, unsigned int size, unsigned int num);
+  int graphFramesTimeTagged(const double *times, double weight, PiPoValue *values, unsigned int size, unsigned int num);
+  int graphFramesVarSize(const double *times, double weight, PiPoValue *values, const unsigned int *sizes, unsigned int num);
+  std::string getTuningKey();
 
   void setOutputStreamAttributes(bool hasTimeTags, double rate, double offset,
                                  unsigned int width, unsigned int height,
@@ -134,6 +302,8 @@ private:
   // std::atomic<int> writeIndex, readIndex;
   int writeIndex, readIndex;
   std::vector<std::vector<PiPoValue> > ringBuffer;
+  double period;                 // ms between the frames of a block, 0 for time-tagged streams
+  std::vector<double> frame;     // frame gathered from a planar block (room for any value type)
 
 public:
   PiPoOut(PiPoHost *host);
@@ -148,6 +318,11 @@ public:
   int frames(double time, double weight, PiPoValue *values,
              unsigned int size, unsigned int num);
 
+  int framesVarSize(const double *times, double weight, PiPoValue *values,
+                    const unsigned int *sizes, unsigned int num);
+
+  void negotiateInputFormat(PiPoStreamFormat &format);
+
   std::vector<PiPoValue> getLastFrame();
 };
 
@@ -0,0 +1,526 @@
+/**
+ * @file PiPoMemoryPlanner.h
+ *
+ * @brief Placement of the buffers of a graph of PiPo modules in a single memory arena.
+ *
+ * After stream attributes propagation, the planner collects the buffers that the modules
+ * declared with PiPo::declareBuffer(), works out which of them are never used at the same
+ * time, and carves all of them from one arena, allocated at most once per reconfiguration.
+ *
+ * Frames are pushed synchronously through a graph, so that the output buffers of a
+ * sequence of modules are all in use while its last module runs.  The buffers of
+ * the branches of a parallel section however are not used anymore once a branch
+ * has passed its frames to the merge module, and can share memory with the
+ * buffers of the following branches.  The buffers of the last branch stay in use
+ * while the merge passes its frames on to the modules following the parallel section.
+ * Persistent buffers are never shared.
+ *
+ * The arena can be locked in physical memory and use huge pages, where the
+ * system supports it.
+ *
+ * The planner also computes the scratch memory needed by the graph (the largest
+ * sum of the scratch sizes declared with PiPo::declareScratch() along a path
+ * through the graph).  By default, it provides one scratch arena shared by all
+ * modules of the graph.  With setSharedScratch(), the host instead guarantees
+ * to bind a PiPoScratchArena of at least getScratchSize() bytes to each thread
+ * executing the graph, shared by all graphs running on that thread.
+ *
+ * @copyright
+ * Copyright (c) 2012–2016 by IRCAM – Centre Pompidou, Paris, France.
+ * All rights reserved.
+ *
+ * License (BSD 3-clause)
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef _PIPO_MEMORY_PLANNER_
+#define _PIPO_MEMORY_PLANNER_
+
+#include "PiPo.h"
+
+#include <vector>
+#include <algorithm>
+#include <climits>
+#include <cstdlib>
+
+#if defined(_WIN32)
+#include <windows.h>
+#elif defined(__unix__) || defined(__APPLE__)
+#include <sys/mman.h>
+#define PIPO_PLANNER_MMAP 1
+#endif
+
+class PiPoMemoryPlanner
+{
+public:
+  /** alignment of each buffer in the arena (cache line size) */
+  static const size_t alignment = 64;
+
+private:
+  /** offset of a block not placed by the last plan */
+  static const size_t unplaced = (size_t) -1;
+
+  /** a declared buffer and its placement */
+  struct Block
+  {
+    PiPo *pipo;
+    unsigned int index;   // index in pipo's buffer requests
+    PiPoValue **slot;     // module's pointer, identifies the buffer from one plan to the next
+    size_t size;          // bytes, rounded up to alignment
+    size_t offset;        // bytes from start of arena
+    size_t previous;      // offset in the last plan, unplaced if none or of another size
+    unsigned int start;   // first step of use
+    unsigned int end;     // last step of use
+    bool persistent;
+    bool kept;            // not declared again since the last plan, keeps offset and contents
+
+    static bool biggerThan (const Block *a, const Block *b) { return a->size > b->size; }
+    bool overlaps (const Block &other) const { return start <= other.end  &&  other.start <= end; }
+    bool collides (const Block &other, size_t at) const
+    { return overlaps(other)  &&  at < other.offset + other.size  &&  other.offset < at + size; }
+  };
+
+  /** visits graph in order of processing to collect blocks with their lifetime steps */
+  class Collector : public PiPo::BufferVisitor
+  {
+    std::vector<Block> &blocks_;
+    std::vector<size_t> branches_; // index of first block of each open branch
+    unsigned int step_;
+    std::vector<size_t> scratchStack_; // scratch depth at start of each open branch
+    size_t scratchDepth_;
+
+  public:
+    size_t scratchSize;
+
+    Collector (std::vector<Block> &blocks)
+    : blocks_(blocks), branches_(), step_(0), scratchStack_(), scratchDepth_(0), scratchSize(0)
+    { }
+
+    void module (PiPo *pipo)
+    {
+      PiPo::BufferList &requests = pipo->getBufferRequests();
+
+      // scratch of nested calls stacks up
+      scratchDepth_ += pipo->getScratchSize();
+
+      if (scratchDepth_ > scratchSize)
+        scratchSize = scratchDepth_;
+
+      for (unsigned int i = 0; i < requests.size(); i++)
+      {
+        Block block;
+
+        block.pipo       = pipo;
+        block.index      = i;
+        block.slot       = requests[i].slot;
+        block.size       = (requests[i].numValues * sizeof(PiPoValue) + alignment - 1) / alignment * alignment;
+        block.offset     = 0;
+        block.previous   = unplaced;
+        block.persistent = requests[i].lifetime == PiPo::BufferPersistent;
+        block.kept       = requests[i].placed;
+        block.start      = block.persistent  ?  0  :  step_;
+        block.end        = UINT_MAX; // until end of enclosing branch
+        blocks_.push_back(block);
+      }
+
+      step_++;
+    }
+
+    void beginBranch ()
+    {
+      branches_.push_back(blocks_.size());
+      scratchStack_.push_back(scratchDepth_);
+      step_++;
+    }
+
+    void endBranch (bool live)
+    {
+      if (!live)
+      { // output buffers opened in the branch are not used anymore
+        for (size_t i = branches_.back(); i < blocks_.size(); i++)
+          if (!blocks_[i].persistent  &&  blocks_[i].end == UINT_MAX)
+            blocks_[i].end = step_;
+
+        scratchDepth_ = scratchStack_.back();
+      }
+      // else the branch's buffers and scratch stay in use by the following modules, until the end of the enclosing branch
+
+      branches_.pop_back();
+      scratchStack_.pop_back();
+      step_++;
+    }
+  };
+
+  /** sets the planner of all visited modules */
+  class Attacher : public PiPo::BufferVisitor
+  {
+    const void *planner_;
+
+  public:
+    Attacher (const void *planner) : planner_(planner) { }
+    void module (PiPo *pipo) { pipo->setBufferPlanner(planner_); }
+  };
+
+  /** sets the fallback scratch arena of all visited modules */
+  class ScratchBinder : public PiPo::BufferVisitor
+  {
+    PiPoScratchArena *arena_;
+
+  public:
+    ScratchBinder (PiPoScratchArena *arena) : arena_(arena) { }
+    void module (PiPo *pipo) { pipo->setScratchArena(arena_); }
+  };
+
+  std::vector<Block> blocks;
+  char *arena;
+  size_t arenaSize;
+  size_t planSize;
+  size_t requestSize;
+  bool lockPages;
+  bool hugePages;
+  bool locked;
+  PiPoScratchArena scratch;
+  size_t scratchSize;
+  bool sharedScratch;
+
+public:
+  PiPoMemoryPlanner ()
+  : blocks(), arena(NULL), arenaSize(0), planSize(0), requestSize(0), lockPages(false), hugePages(false), locked(false),
+    scratch(), scratchSize(0), sharedScratch(false)
+  { }
+
+  /** copy takes the options, but not the arena */
+  PiPoMemoryPlanner (const PiPoMemoryPlanner &other)
+  : blocks(), arena(NULL), arenaSize(0), planSize(0), requestSize(0), lockPages(other.lockPages), hugePages(other.hugePages), locked(false),
+    scratch(), scratchSize(0), sharedScratch(other.sharedScratch)
+  { }
+
+  PiPoMemoryPlanner &operator= (const PiPoMemoryPlanner &other)
+  {
+    lockPages = other.lockPages;
+    hugePages = other.hugePages;
+    sharedScratch = other.sharedScratch;
+    return *this;
+  }
+
+  ~PiPoMemoryPlanner ()
+  {
+    freeArena();
+  }
+
+  /** @name options, taking effect on the next (re)allocation of the arena */
+  /** @{ */
+
+  /** lock arena in physical memory (if the system and user limits allow it) */
+  void setLockPages (bool lock) { lockPages = lock; }
+  bool getLockPages () const { return lockPages; }
+
+  /** advise the system to back the arena with huge pages (Linux transparent huge pages) */
+  void setHugePages (bool huge) { hugePages = huge; }
+  bool getHugePages () const { return hugePages; }
+
+  /** the host binds a scratch arena of at least getScratchSize() bytes to each processing thread, instead of using one per graph */
+  void setSharedScratch (bool shared) { sharedScratch = shared; }
+  bool getSharedScratch () const { return sharedScratch; }
+
+  /** @} */
+
+  /** @name planning */
+  /** @{ */
+
+  /** let the planner place the buffers of all modules of graph, to be called before stream attributes propagation */
+  void attach (PiPo *graph)
+  {
+    Attacher attacher(this);
+    graph->visitBuffers(attacher);
+  }
+
+  /** let the modules of graph allocate their buffers themselves again */
+  void detach (PiPo *graph)
+  {
+    Attacher attacher(NULL);
+    graph->visitBuffers(attacher);
+  }
+
+  /** place the buffers declared by the modules of graph in the arena and bind them, to be called after stream attributes propagation
+
+      Only the buffers declared since the last plan (by the modules whose streamAttributes() was called) are placed anew
+      and persistent ones cleared, the others keep their offset and contents, so that the modules not reconfigured
+      (e.g. skipped by PiPo::setStreamAttributesCache()) keep their state.  Buffers declared again with the same size keep
+      their offset where it is still free.
+      If the arena has to grow, it is reallocated and the kept contents are copied.
+
+      @return 0 for ok, -1 if the arena could not be allocated (the modules then allocate their buffers privately)
+   */
+  int plan (PiPo *graph)
+  {
+    std::vector<Block> last;
+    Collector collector(blocks);
+    std::vector<Block *> order;
+
+    last.swap(blocks);
+    graph->visitBuffers(collector);
+
+    for (size_t i = 0; i < blocks.size(); i++)
+    { // find placement of the last plan
+      Block &block = blocks[i];
+
+      for (size_t j = 0; j < last.size(); j++)
+        if (last[j].pipo == block.pipo  &&  last[j].slot == block.slot)
+        {
+          if (last[j].size == block.size  &&  last[j].persistent == block.persistent)
+            block.previous = last[j].offset;
+
+          break;
+        }
+
+      block.kept = block.kept  &&  block.previous != unplaced  &&  arena != NULL;
+    }
+
+    scratchSize = collector.scratchSize;
+
+    if (!sharedScratch)
+      scratch.reserve(scratchSize);
+
+    ScratchBinder binder(sharedScratch  ?  NULL  :  &scratch);
+    graph->visitBuffers(binder);
+
+    // place biggest blocks first at lowest possible offset not overlapping blocks in use at the same time
+    requestSize = 0;
+    planSize = 0;
+
+    size_t numKept = 0;
+
+    for (size_t i = 0; i < blocks.size(); i++)
+    { // kept blocks stay where they are, unless they collide with another one kept
+      Block &block = blocks[i];
+
+      requestSize += block.size;
+
+      if (block.kept)
+      {
+        for (size_t k = 0; k < numKept; k++)
+          if (block.collides(*order[k], block.previous))
+          {
+            block.kept = false;
+            break;
+          }
+      }
+
+      if (block.kept)
+      {
+        block.offset = block.previous;
+        order.insert(order.begin() + numKept++, &block);
+      }
+      else
+        order.push_back(&block);
+    }
+
+    // place the others, biggest first, at their last offset if free (same size), otherwise the lowest offset not colliding
+    std::stable_sort(order.begin() + numKept, order.end(), Block::biggerThan);
+
+    for (size_t i = numKept; i < order.size(); i++)
+    {
+      Block *block = order[i];
+      std::vector<size_t> candidates(1, 0);
+
+      for (size_t j = 0; j < i; j++)
+        if (order[j]->overlaps(*block))
+          candidates.push_back(order[j]->offset + order[j]->size);
+
+      std::sort(candidates.begin(), candidates.end());
+
+      if (block->previous != unplaced)
+        candidates.insert(candidates.begin(), block->previous);
+
+      for (size_t c = 0; c < candidates.size(); c++)
+      {
+        size_t k;
+
+        for (k = 0; k < i; k++)
+          if (block->collides(*order[k], candidates[c]))
+            break;
+
+        if (k == i)
+        {
+          block->offset = candidates[c];
+          break;
+        }
+      }
+    }
+
+    for (size_t i = 0; i < order.size(); i++)
+      if (order[i]->offset + order[i]->size > planSize)
+        planSize = order[i]->offset + order[i]->size;
+
+    if (planSize > arenaSize  &&  !growArena(planSize, order, numKept))
+    { // fall back to private allocation
+      for (size_t i = 0; i < blocks.size(); i++)
+        blocks[i].pipo->bindBuffer(blocks[i].index, NULL);
+
+      blocks.clear();
+      return -1;
+    }
+
+    for (size_t i = 0; i < blocks.size(); i++)
+    {
+      Block &block = blocks[i];
+
+      if (block.size > 0)
+      {
+        if (block.persistent  &&  !block.kept)
+          memset(arena + block.offset, 0, block.size);
+
+        block.pipo->bindBuffer(block.index, reinterpret_cast<PiPoValue *>(arena + block.offset));
+      }
+      else
+        block.pipo->bindBuffer(block.index, NULL);
+    }
+
+    return 0;
+  }
+
+  /** @} */
+
+  /** @name query */
+  /** @{ */
+
+  /** size of arena in bytes */
+  size_t getArenaSize () const { return arenaSize; }
+
+  /** size in bytes used by the last plan */
+  size_t getPlanSize () const { return planSize; }
+
+  /** size in bytes the buffers of the last plan would use without sharing */
+  size_t getRequestSize () const { return requestSize; }
+
+  /** true if the arena is locked in physical memory */
+  bool isLocked () const { return locked; }
+
+  /** scratch memory in bytes needed by the graph at the last plan, to reserve the threads' scratch arenas */
+  size_t getScratchSize () const { return scratchSize; }
+
+  /** @} */
+
+private:
+  /** reallocate arena, copying the contents of the kept blocks (the first numKept of order) */
+  bool growArena (size_t size, const std::vector<Block *> &order, size_t numKept)
+  {
+    if (numKept == 0)
+      return allocArena(size);
+
+    char *old = arena;
+    size_t oldSize = arenaSize;
+    bool oldLocked = locked;
+
+    arena = NULL; // keep the old arena until the contents are copied
+
+    if (!allocArena(size))
+    {
+      arena = old;
+      arenaSize = oldSize;
+      locked = oldLocked;
+      return false;
+    }
+
+    for (size_t i = 0; i < numKept; i++)
+      memcpy(arena + order[i]->offset, old + order[i]->offset, order[i]->size);
+
+    releaseMemory(old, oldSize, oldLocked);
+    return true;
+  }
+
+  bool allocArena (size_t size)
+  {
+    freeArena();
+
+#if defined(_WIN32)
+    arena = (char *) VirtualAlloc(NULL, size, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE);
+
+    if (arena == NULL)
+      return false;
+
+    locked = lockPages  &&  VirtualLock(arena, size) != 0;
+#elif defined(PIPO_PLANNER_MMAP)
+    void *mem = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANON, -1, 0);
+
+    if (mem == MAP_FAILED)
+      return false;
+
+    arena = (char *) mem;
+#  ifdef MADV_HUGEPAGE
+    if (hugePages)
+      madvise(mem, size, MADV_HUGEPAGE);
+#  endif
+    locked = lockPages  &&  mlock(mem, size) == 0;
+#else
+    arena = (char *) malloc(size);
+
+    if (arena == NULL)
+      return false;
+#endif
+
+    arenaSize = size;
+    return true;
+  }
+
+  static void releaseMemory (char *mem, size_t size, bool isLocked)
+  {
+    if (mem != NULL)
+    {
+#if defined(_WIN32)
+      if (isLocked)
+        VirtualUnlock(mem, size);
+
+      VirtualFree(mem, 0, MEM_RELEASE);
+#elif defined(PIPO_PLANNER_MMAP)
+      if (isLocked)
+        munlock(mem, size);
+
+      munmap(mem, size);
+#else
+      free(mem);
+#endif
+    }
+  }
+
+  void freeArena ()
+  {
+    releaseMemory(arena, arenaSize, locked);
+    arena = NULL;
+    arenaSize = 0;
+    locked = false;
+  }
+};
+
+/** EMACS **
+ * Local variables:
+ * mode: c++
+ * c-basic-offset:2
+ * End:
+ */
+
+#endif /* _PIPO_MEMORY_PLANNER_ */
@@ -136,8 +136,17 @@ public:
     { // check if version of created pipo is compatible with host
       if (this->pipo->getVersion() < PIPO_MIN_SDK_VERSION_REQUIRED)
       {
-        printf("PiPo Host ERROR: created PiPo %s version %f is smaller than minimum required version %f\n",
-        this->pipoName.c_str(), this->pipo->getVersion(), PIPO_MIN_SDK_VERSION_REQUIRED);
+        PiPoDiagnostic diagnostic(PiPoDiagnostic::VersionMismatch, PiPoDiagnostic::Error, this->pipo,
+                                  "created PiPo version %g is smaller than minimum required version %g");
+
+        diagnostic.values[0] = this->pipo->getVersion();
+        diagnostic.values[1] = PIPO_MIN_SDK_VERSION_REQUIRED;
+
+        if (parent != NULL)
+          parent->postDiagnostic(this->pipo, diagnostic);
+        else
+          printf("PiPo Host ERROR: created PiPo %s version %f is smaller than minimum required version %f\n",
+                 this->pipoName.c_str(), this->pipo->getVersion(), PIPO_MIN_SDK_VERSION_REQUIRED);
         //TODO: clean up: destroy unusable pipo
         return false;
       }